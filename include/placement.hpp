@@ -0,0 +1,198 @@
+#ifndef PLACEMENT_HPP
+#define PLACEMENT_HPP
+
+#include <unistd.h>
+#include <sys/types.h>
+
+#ifdef __linux__
+# include <sched.h>
+# include <dirent.h>
+# include <sys/syscall.h>
+# include <linux/mempolicy.h>
+#endif
+
+#include <map>
+#include <set>
+#include <tuple>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include "topology.hpp"
+
+// Pins the threads of an actor system (i.e., its scheduler workers) and sets
+// the NUMA memory policy for all threads it starts:
+//
+//   auto placement = thread_placement::from_args(argc, argv);
+//   ...
+//   placement.prepare();
+//   actor_system system{cfg};
+//   placement.apply(cfg.scheduler_max_threads);
+//
+// --pin=compact   fills all SMT siblings of a core, then all cores of a
+//                 package, then the next package
+// --pin=scatter   round-robin over NUMA nodes and packages, SMT siblings last
+// --pin=physical  one thread per physical core, SMT siblings only after all
+//                 cores are taken
+// --numa-mem=local       allocate on the node of the allocating thread
+// --numa-mem=interleave  interleave pages over the nodes of all usable CPUs
+// --numa-mem=bind        allocate only from nodes of the usable CPUs
+//
+// Both only take effect on Linux, prepare() and apply() do nothing elsewhere.
+
+class thread_placement {
+public:
+    // consumes --pin=POLICY and --numa-mem=POLICY from the command line,
+    // exits on invalid policies
+    static thread_placement from_args(int& argc, char** argv) {
+        thread_placement result;
+        int out = 1;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.compare(0, 6, "--pin=") == 0) {
+                result.pin_ = arg.substr(6);
+            } else if (arg.compare(0, 11, "--numa-mem=") == 0) {
+                result.mem_ = arg.substr(11);
+            } else {
+                argv[out++] = argv[i];
+            }
+        }
+        argc = out;
+        argv[argc] = nullptr;
+        auto pins = {"none", "compact", "scatter", "physical"};
+        auto mems = {"default", "local", "interleave", "bind"};
+        if (std::find(pins.begin(), pins.end(), result.pin_) == pins.end()
+            || std::find(mems.begin(), mems.end(), result.mem_) == mems.end()) {
+            std::cerr << "usage: --pin=none|compact|scatter|physical"
+                         " --numa-mem=default|local|interleave|bind"
+                      << std::endl;
+            exit(1);
+        }
+        return result;
+    }
+
+    // CPUs in the order threads get pinned to them
+    static std::vector<int> cpu_order(const topology& topo,
+                                      const std::string& policy) {
+        auto cpus = topo.cpus();
+        std::sort(cpus.begin(), cpus.end(),
+                  [](const cpu_info& x, const cpu_info& y) {
+            return std::make_tuple(x.node, x.package, x.core, x.id)
+                   < std::make_tuple(y.node, y.package, y.core, y.id);
+        });
+        // first CPU of every core, followed by the remaining SMT siblings
+        auto cores_first = [](const std::vector<cpu_info>& xs) {
+            std::vector<cpu_info> result;
+            std::vector<cpu_info> siblings;
+            std::set<std::pair<int, int>> seen;
+            for (auto& x : xs) {
+                if (seen.emplace(x.package, x.core).second)
+                    result.push_back(x);
+                else
+                    siblings.push_back(x);
+            }
+            result.insert(result.end(), siblings.begin(), siblings.end());
+            return result;
+        };
+        if (policy == "physical") {
+            cpus = cores_first(cpus);
+        } else if (policy == "scatter") {
+            std::map<std::pair<int, int>, std::vector<cpu_info>> groups;
+            for (auto& x : cpus)
+                groups[std::make_pair(x.node, x.package)].push_back(x);
+            std::vector<std::vector<cpu_info>> queues;
+            for (auto& kvp : groups)
+                queues.push_back(cores_first(kvp.second));
+            cpus.clear();
+            for (size_t i = 0; cpus.size() < topo.cpus().size(); ++i)
+                for (auto& q : queues)
+                    if (i < q.size())
+                        cpus.push_back(q[i]);
+        }
+        std::vector<int> result;
+        for (auto& x : cpus)
+            result.push_back(x.id);
+        return result;
+    }
+
+    // sets the memory policy of the calling thread, which threads started
+    // afterwards inherit, and remembers all running threads; call right
+    // before starting the actor system
+    void prepare() {
+#ifdef __linux__
+        before_ = threads();
+        if (mem_ == "default")
+            return;
+        auto topo = topology::local();
+        unsigned long mask[16] = {};
+        auto bits = sizeof(unsigned long) * 8;
+        for (auto& cpu : topo.cpus())
+            if (static_cast<size_t>(cpu.node) < sizeof(mask) * 8)
+                mask[cpu.node / bits] |= 1ul << (cpu.node % bits);
+        long res;
+        if (mem_ == "local")
+            res = syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0);
+        else
+            res = syscall(SYS_set_mempolicy,
+                          mem_ == "bind" ? MPOL_BIND : MPOL_INTERLEAVE,
+                          mask, sizeof(mask) * 8);
+        if (res != 0)
+            perror("set_mempolicy");
+#endif
+    }
+
+    // pins the first `num_workers` threads started since `prepare` in
+    // creation order, wrapping around if there are more workers than CPUs;
+    // CAF starts its scheduler workers before the timer, printer and
+    // middleman threads, which stay unpinned; call right after starting the
+    // actor system
+    void apply(size_t num_workers) {
+#ifdef __linux__
+        if (pin_ == "none")
+            return;
+        auto order = cpu_order(topology::local(), pin_);
+        if (order.empty())
+            return;
+        size_t i = 0;
+        for (auto tid : threads()) {
+            if (before_.count(tid) > 0)
+                continue;
+            if (i == num_workers)
+                break;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(order[i++ % order.size()], &set);
+            if (sched_setaffinity(tid, sizeof(set), &set) != 0)
+                perror("sched_setaffinity");
+        }
+#else
+        static_cast<void>(num_workers);
+#endif
+    }
+
+private:
+#ifdef __linux__
+    // returns the IDs of all threads of this process, thread IDs grow with
+    // creation order until they wrap around
+    static std::set<pid_t> threads() {
+        std::set<pid_t> result;
+        if (auto dir = opendir("/proc/self/task")) {
+            while (auto entry = readdir(dir))
+                if (entry->d_name[0] != '.')
+                    result.insert(static_cast<pid_t>(atoi(entry->d_name)));
+            closedir(dir);
+        }
+        return result;
+    }
+#endif
+
+    std::string pin_ = "none";
+    std::string mem_ = "default";
+    std::set<pid_t> before_;
+};
+
+#endif // PLACEMENT_HPP
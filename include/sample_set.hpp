@@ -0,0 +1,59 @@
+#ifndef SAMPLE_SET_HPP
+#define SAMPLE_SET_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+// collects integer samples, e.g., latencies in nanoseconds, and answers
+// percentile queries on them
+class sample_set {
+public:
+    void add(uint64_t x) {
+        samples_.push_back(x);
+        sorted_ = false;
+    }
+
+    size_t count() const {
+        return samples_.size();
+    }
+
+    uint64_t sum() const {
+        uint64_t result = 0;
+        for (auto x : samples_)
+            result += x;
+        return result;
+    }
+
+    // arithmetic mean, 0 if there are no samples
+    double mean() const {
+        if (samples_.empty())
+            return 0;
+        return static_cast<double>(sum()) / static_cast<double>(count());
+    }
+
+    // all samples in insertion order unless percentile() sorted them
+    const std::vector<uint64_t>& samples() const {
+        return samples_;
+    }
+
+    // returns the sample at rank `p` in [0, 1] (rounded down), 0 if there
+    // are no samples; sorts only on the first call after add()
+    uint64_t percentile(double p) {
+        if (samples_.empty())
+            return 0;
+        if (!sorted_) {
+            std::sort(samples_.begin(), samples_.end());
+            sorted_ = true;
+        }
+        auto last = static_cast<double>(samples_.size() - 1);
+        return samples_[static_cast<size_t>(p * last)];
+    }
+
+private:
+    std::vector<uint64_t> samples_;
+    bool sorted_ = true;
+};
+
+#endif // SAMPLE_SET_HPP
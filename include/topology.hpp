@@ -0,0 +1,249 @@
+#ifndef TOPOLOGY_HPP
+#define TOPOLOGY_HPP
+
+#include <dirent.h>
+
+#ifdef __linux__
+# include <sched.h>
+#endif
+
+#include <set>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+// Machine topology as seen by this process, read from /sys/devices/system/cpu
+// and /sys/devices/system/node. Only CPUs that are online and in the affinity
+// mask of the calling thread are included.
+
+struct cpu_info {
+    int id;      // logical CPU number
+    int core;    // core ID, unique within its package
+    int package; // physical package (socket)
+    int node;    // NUMA node, 0 on kernels without NUMA support
+};
+
+struct cache_info {
+    int level;
+    std::string type;      // "Data", "Instruction" or "Unified"
+    size_t size;           // in bytes
+    std::vector<int> cpus; // all CPUs sharing this cache, usable or not
+};
+
+namespace detail {
+
+inline std::string read_line(const std::string& path) {
+    std::ifstream in{path};
+    std::string result;
+    std::getline(in, result);
+    return result;
+}
+
+inline int read_int(const std::string& path, int fallback) {
+    auto str = read_line(path);
+    char* end = nullptr;
+    auto result = strtol(str.c_str(), &end, 10);
+    return str.empty() || end == str.c_str() ? fallback
+                                             : static_cast<int>(result);
+}
+
+// parses kernel CPU lists such as "0-3,8,10-11"
+inline std::vector<int> parse_cpu_list(const std::string& str) {
+    std::vector<int> result;
+    std::stringstream strs{str};
+    std::string range;
+    while (std::getline(strs, range, ',')) {
+        if (range.empty())
+            continue;
+        auto sep = range.find('-');
+        auto first = atoi(range.c_str());
+        auto last = sep == std::string::npos ? first
+                                             : atoi(range.c_str() + sep + 1);
+        for (auto i = first; i <= last; ++i)
+            result.push_back(i);
+    }
+    return result;
+}
+
+// parses sizes such as "32K" or "1M"
+inline size_t parse_size(const std::string& str) {
+    char* end = nullptr;
+    auto result = static_cast<size_t>(strtoull(str.c_str(), &end, 10));
+    switch (end != nullptr ? *end : '\0') {
+        case 'K': return result * 1024;
+        case 'M': return result * 1024 * 1024;
+        case 'G': return result * 1024 * 1024 * 1024;
+        default: return result;
+    }
+}
+
+// returns the CPU quota of the cgroup of this process in CPUs or 0 if
+// unlimited, checking cpu.max (cgroup v2) on the path to the root and
+// cpu.cfs_quota_us (cgroup v1)
+inline double cgroup_cpu_limit() {
+    double result = 0;
+    auto consider = [&](double quota, double period) {
+        if (quota > 0 && period > 0 && (result == 0 || quota / period < result))
+            result = quota / period;
+    };
+    std::ifstream in{"/proc/self/cgroup"};
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 3, "0::") == 0) {
+            auto path = line.substr(3);
+            for (;;) {
+                std::ifstream max_file{"/sys/fs/cgroup" + path + "/cpu.max"};
+                std::string quota;
+                double period = 0;
+                if (max_file >> quota >> period && quota != "max")
+                    consider(atof(quota.c_str()), period);
+                if (path.empty() || path == "/")
+                    break;
+                path.erase(path.rfind('/'));
+            }
+        }
+    }
+    for (auto dir : {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"})
+        consider(read_int(std::string{dir} + "/cpu.cfs_quota_us", -1),
+                 read_int(std::string{dir} + "/cpu.cfs_period_us", -1));
+    return result;
+}
+
+} // namespace detail
+
+class topology {
+public:
+    // reads the topology of this machine
+    static topology local() {
+        topology result;
+        const std::string sys_cpu = "/sys/devices/system/cpu/";
+        auto online = detail::parse_cpu_list(detail::read_line(sys_cpu
+                                                               + "online"));
+#ifdef __linux__
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        bool has_mask = sched_getaffinity(0, sizeof(mask), &mask) == 0;
+        for (auto id : online)
+            if (!has_mask || CPU_ISSET(id, &mask))
+                result.cpus_.push_back(cpu_info{id, id, 0, 0});
+#endif
+        if (result.cpus_.empty()) {
+            // no sysfs, assume a flat machine
+            int n = static_cast<int>(std::thread::hardware_concurrency());
+            for (int id = 0; id < std::max(n, 1); ++id)
+                result.cpus_.push_back(cpu_info{id, id, 0, 0});
+            return result;
+        }
+        std::set<std::pair<int, std::string>> seen_caches;
+        for (auto& cpu : result.cpus_) {
+            auto dir = sys_cpu + "cpu" + std::to_string(cpu.id) + "/";
+            cpu.core = detail::read_int(dir + "topology/core_id", cpu.id);
+            cpu.package = detail::read_int(dir
+                                           + "topology/physical_package_id",
+                                           0);
+            for (int i = 0;; ++i) {
+                auto index = dir + "cache/index" + std::to_string(i) + "/";
+                auto level = detail::read_int(index + "level", -1);
+                if (level < 0)
+                    break;
+                auto shared = detail::read_line(index + "shared_cpu_list");
+                auto type = detail::read_line(index + "type");
+                if (!seen_caches.emplace(level, type + shared).second)
+                    continue;
+                result.caches_.push_back(cache_info{
+                    level, type, detail::parse_size(detail::read_line(index
+                                                                      + "size")),
+                    detail::parse_cpu_list(shared)});
+            }
+        }
+        const std::string sys_node = "/sys/devices/system/node/";
+        if (auto dir = opendir(sys_node.c_str())) {
+            while (auto entry = readdir(dir)) {
+                std::string name = entry->d_name;
+                if (name.compare(0, 4, "node") != 0 || name.size() == 4)
+                    continue;
+                auto node = atoi(name.c_str() + 4);
+                for (auto id : detail::parse_cpu_list(
+                         detail::read_line(sys_node + name + "/cpulist")))
+                    for (auto& cpu : result.cpus_)
+                        if (cpu.id == id)
+                            cpu.node = node;
+            }
+            closedir(dir);
+        }
+        result.cgroup_limit_ = detail::cgroup_cpu_limit();
+        return result;
+    }
+
+    // online CPUs in the affinity mask, sorted by ID
+    const std::vector<cpu_info>& cpus() const {
+        return cpus_;
+    }
+
+    // IDs of cpus(), e.g. for building affinity masks
+    std::vector<int> cpu_ids() const {
+        std::vector<int> result;
+        for (auto& cpu : cpus_)
+            result.push_back(cpu.id);
+        return result;
+    }
+
+    // distinct caches of all usable CPUs
+    const std::vector<cache_info>& caches() const {
+        return caches_;
+    }
+
+    size_t packages() const {
+        return count_distinct([](const cpu_info& x) {
+            return std::make_pair(x.package, 0);
+        });
+    }
+
+    // number of physical cores, i.e., CPUs minus SMT siblings
+    size_t physical_cores() const {
+        return count_distinct([](const cpu_info& x) {
+            return std::make_pair(x.package, x.core);
+        });
+    }
+
+    size_t numa_nodes() const {
+        return count_distinct([](const cpu_info& x) {
+            return std::make_pair(x.node, 0);
+        });
+    }
+
+    // CPU quota of the cgroup of this process in CPUs, 0 if unlimited
+    double cgroup_limit() const {
+        return cgroup_limit_;
+    }
+
+    // number of threads this process can keep busy: the usable CPUs,
+    // further limited by the cgroup quota (rounded up)
+    size_t usable_cpus() const {
+        auto result = cpus_.size();
+        if (cgroup_limit_ > 0)
+            result = std::min(result,
+                              static_cast<size_t>(std::ceil(cgroup_limit_)));
+        return std::max(result, size_t{1});
+    }
+
+private:
+    template <class F>
+    size_t count_distinct(F key) const {
+        std::set<std::pair<int, int>> keys;
+        for (auto& cpu : cpus_)
+            keys.insert(key(cpu));
+        return keys.size();
+    }
+
+    std::vector<cpu_info> cpus_;
+    std::vector<cache_info> caches_;
+    double cgroup_limit_ = 0;
+};
+
+#endif // TOPOLOGY_HPP
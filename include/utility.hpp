@@ -7,6 +7,8 @@
 #include <stdexcept>
 #include <algorithm>
 
+#include "topology.hpp"
+
 inline std::vector<std::string> split(const std::string& str, char delim) {
     std::vector<std::string> result;
     std::stringstream strs{str};
@@ -40,17 +42,10 @@ T rd(const char* cstr) {
     return result;
 }
 
+// number of CPUs this process can keep busy, honoring affinity masks and
+// cgroup CPU quotas
 int num_cores() {
-    char cbuf[100];
-    FILE* cmd = popen("/bin/cat /proc/cpuinfo | /bin/grep processor | /usr/bin/wc -l", "r");
-    if (fgets(cbuf, 100, cmd) == 0) {
-        throw std::runtime_error("cannot determine number of cores");
-    }
-    pclose(cmd);
-    // erase trailing newline
-    auto i = std::find(cbuf, cbuf + 100, '\n');
-    *i = '\0';
-    return rd<int>(cbuf);
+    return static_cast<int>(topology::local().usable_cpus());
 }
 
 std::vector<uint64_t> factorize(uint64_t n) {
@@ -24,6 +24,9 @@
 
 #include "caf/all.hpp"
 
+#include "topology.hpp"
+#include "placement.hpp"
+
 using namespace std;
 using namespace caf;
 
@@ -81,12 +84,16 @@ void usage() {
 }
 
 int main(int argc, char** argv) {
+  auto placement = thread_placement::from_args(argc, argv);
   if (argc != 2)
     usage();
   s_num = static_cast<uint32_t>(std::stoi(argv[1]));
   actor_system_config cfg;
+  cfg.scheduler_max_threads = topology::local().usable_cpus();
   cfg.parse(argc, argv, "caf-application.ini");
+  placement.prepare();
   actor_system system{cfg};
+  placement.apply(cfg.scheduler_max_threads);
   scoped_actor self{system};
   anon_send(system.spawn<lazy_init>(testee, self), spread_atom::value, s_num);
 }
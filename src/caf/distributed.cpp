@@ -17,347 +17,772 @@
  * http://www.boost.org/LICENSE_1_0.txt.                                      *
  ******************************************************************************/
 
+#include <sched.h>
+#include <dirent.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+#include <linux/perf_event.h>
+
+#include <map>
 #include <chrono>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <fstream>
 #include <utility>
 #include <iostream>
+#include <algorithm>
 
 #include "caf/all.hpp"
 #include "caf/io/all.hpp"
 
+#include "topology.hpp"
+#include "sample_set.hpp"
+#include "placement.hpp"
+
 using namespace std;
 using namespace caf;
 
+using ping_atom = atom_constant<atom("ping")>;
+using pong_atom = atom_constant<atom("pong")>;
+using kickoff_atom = atom_constant<atom("kickoff")>;
+using add_pong_atom = atom_constant<atom("add_pong")>;
+using purge_atom = atom_constant<atom("purge")>;
+using shutdown_atom = atom_constant<atom("shutdown")>;
+using done_atom = atom_constant<atom("done")>;
+using ok_atom = atom_constant<atom("ok")>;
+using error_atom = atom_constant<atom("error")>;
+using stats_atom = atom_constant<atom("stats")>;
+
+using hrc = std::chrono::high_resolution_clock;
+
 namespace {
 
-void usage() {
-    cout << "Running in server mode:"                                    << endl
-         << "  mode=server  "                                            << endl
-         << "  --port=NUM       publishes an actor at port NUM"          << endl
-         << "  -p NUM           alias for --port=NUM"                    << endl
-         << endl
-         << endl
-         << "Running the benchmark:"                                     << endl
-         << "  mode=benchmark run the benchmark, connect to any number"  << endl
-         << "                 of given servers, use HOST:PORT syntax"    << endl
-         << "  num_pings=NUM  run benchmark with NUM messages per node"  << endl
-         << endl
-         << "  example: mode=benchmark 192.168.9.1:1234 "
-                                        "192.168.9.2:1234 "
-                                        "--num_pings=100"                << endl
-         << endl
-         << endl
-         << "Shutdown servers:"                                          << endl
-         << "  mode=shutdown  shuts down any number of given servers"    << endl
-         << endl
-         << endl
-         << "Miscellaneous:"                                             << endl
-         << "  -h, --help       print this text and exit"                << endl
-         << endl;
-    exit(0);
+using node = pair<string, uint16_t>;
+
+// collects the round-trip times of one ping actor in nanoseconds
+class rtt_stats {
+public:
+  void add(hrc::time_point sent, hrc::time_point received) {
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+    auto ns = duration_cast<nanoseconds>(received - sent).count();
+    samples_.add(static_cast<uint64_t>(ns));
+  }
+
+  uint64_t count() const {
+    return samples_.count();
+  }
+
+  uint64_t sum() const {
+    return samples_.sum();
+  }
+
+  uint64_t percentile(double p) {
+    return samples_.percentile(p);
+  }
+
+private:
+  sample_set samples_;
+};
+
+// counters of one process telling how much traffic the middleman puts on the
+// wire and how many syscalls it needs for that
+struct wire_sample {
+  uint64_t bytes_out = 0;     // TCP payload bytes sent and acked
+  uint64_t bytes_in = 0;      // TCP payload bytes received
+  uint64_t segments_out = 0;  // TCP segments carrying data
+  uint64_t send_calls = 0;
+  uint64_t recv_calls = 0;
+};
+
+// sums the counters of all TCP sockets of this process
+void add_tcp_stats(wire_sample& x) {
+  auto dir = opendir("/proc/self/fd");
+  if (dir == nullptr)
+    return;
+  while (auto entry = readdir(dir)) {
+    if (entry->d_name[0] == '.')
+      continue;
+    tcp_info info;
+    memset(&info, 0, sizeof(info));
+    socklen_t len = sizeof(info);
+    // fails for anything but TCP sockets
+    if (getsockopt(atoi(entry->d_name), IPPROTO_TCP, TCP_INFO, &info, &len)
+        != 0)
+      continue;
+    if (len < offsetof(tcp_info, tcpi_data_segs_out)
+              + sizeof(info.tcpi_data_segs_out))
+      continue;
+    x.bytes_out += info.tcpi_bytes_acked;
+    x.bytes_in += info.tcpi_bytes_received;
+    x.segments_out += info.tcpi_data_segs_out;
+  }
+  closedir(dir);
 }
 
+// counts send/recv syscalls of this process and of all threads it starts
+// afterwards via perf tracepoints; without tracefs or permissions there is
+// no counter covering sendto/recvfrom and syscalls are reported as n/a
+class syscall_counters {
+public:
+  // must run before the actor system starts its threads
+  void open() {
+    precise_ = add(send_fds_, "sys_enter_sendto")
+               && add(send_fds_, "sys_enter_sendmsg")
+               && add(recv_fds_, "sys_enter_recvfrom")
+               && add(recv_fds_, "sys_enter_recvmsg");
+  }
+
+  bool precise() const {
+    return precise_;
+  }
+
+  void sample(wire_sample& x) const {
+    if (precise_) {
+      x.send_calls += sum(send_fds_);
+      x.recv_calls += sum(recv_fds_);
+    }
+  }
+
+private:
+  static bool add(vector<int>& fds, const char* event) {
+    for (auto dir : {"/sys/kernel/tracing", "/sys/kernel/debug/tracing"}) {
+      ifstream in{string{dir} + "/events/syscalls/" + event + "/id"};
+      uint64_t id;
+      if (!(in >> id))
+        continue;
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_TRACEPOINT;
+      attr.config = id;
+      attr.inherit = 1;
+      auto fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1,
+                                         -1, 0));
+      if (fd < 0)
+        return false;
+      fds.push_back(fd);
+      return true;
+    }
+    return false;
+  }
+
+  static uint64_t sum(const vector<int>& fds) {
+    uint64_t result = 0;
+    for (auto fd : fds) {
+      uint64_t value = 0;
+      if (read(fd, &value, sizeof(value)) == sizeof(value))
+        result += value;
+    }
+    return result;
+  }
+
+  bool precise_ = false;
+  vector<int> send_fds_;
+  vector<int> recv_fds_;
+};
+
+syscall_counters s_syscalls;
+
+// sends `num_pings + 1` pings to a remote server actor, one at a time, and
+// reports {done, node, count, sum, p50, p99, max, elapsed} to `parent`
+// afterwards, where all times are in ns and `node` identifies the server
+// running this actor
 class ping_actor : public event_based_actor {
 public:
-  ping_actor(actor_config& cfg, actor parent)
+  ping_actor(actor_config& cfg, actor parent, uint32_t node_id,
+             uint32_t payload_size)
       : event_based_actor(cfg),
-        parent_(move(parent)) {
+        parent_(std::move(parent)),
+        node_id_(node_id),
+        payload_(payload_size, 'x') {
     // nop
   }
 
   behavior make_behavior() override {
     return {
-      on(atom("kickoff"), arg_match) >> [=](actor pong, uint32_t value) {
-        send(pong, atom("ping"), value);
-        become (
-          on(atom("pong"), uint32_t(0)) >> [=] {
-            send(parent_, atom("done"));
-            quit();
-          },
-          on(atom("pong"), arg_match) >> [=](uint32_t x) {
-            return make_tuple(atom("ping"), x - 1);
-          },
-          others >> [=] {
-            cout << "ping_actor: unexpected: "
-                 << to_string(current_message())
-                 << endl;
+      [=](kickoff_atom, const actor& pong, uint32_t value) {
+        start_ = hrc::now();
+        sent_ = start_;
+        send(pong, ping_atom::value, value, payload_);
+        become(
+          [=](pong_atom, uint32_t x, const string&) {
+            auto now = hrc::now();
+            rtts_.add(sent_, now);
+            if (x == 0) {
+              using std::chrono::duration_cast;
+              using std::chrono::nanoseconds;
+              auto elapsed = duration_cast<nanoseconds>(now - start_).count();
+              send(parent_, done_atom::value, node_id_, rtts_.count(),
+                   rtts_.sum(), rtts_.percentile(0.5), rtts_.percentile(0.99),
+                   rtts_.percentile(1.0), static_cast<uint64_t>(elapsed));
+              quit();
+              return;
+            }
+            sent_ = now;
+            send(pong, ping_atom::value, x - 1, payload_);
           }
         );
-      },
-      others >> [=] {
-          cout << "ping_actor: unexpected: "
-               << to_string(current_message())
-               << endl;
       }
     };
   }
 
 private:
   actor parent_;
+  uint32_t node_id_;
+  string payload_;
+  hrc::time_point start_;
+  hrc::time_point sent_;
+  rtt_stats rtts_;
 };
 
 class server_actor : public event_based_actor {
 public:
-    typedef map<pair<string, uint16_t>, actor> pong_map;
-
-    behavior make_behavior() override {
-      trap_exit(true);
-      return {
-        on(atom("ping"), arg_match) >> [=](uint32_t value) {
-          return make_tuple(atom("pong"), value);
-        },
-        on(atom("add_pong"), arg_match) >> [=](const string& host, uint16_t port) -> message {
-          auto key = make_pair(host, port);
-          auto i = m_pongs.find(key);
-          if (i == m_pongs.end()) {
-            try {
-              auto p = system().middleman().remote_actor(host.c_str(), port);
-              link_to(p);
-              m_pongs.insert(make_pair(key, p));
-            }
-            catch (exception& e) {
-              return make_message(atom("error"), e.what());
-            }
-          }
-          return make_message(atom("ok"));
-        },
-        on(atom("kickoff"), arg_match) >> [=](uint32_t num_pings, actor buddy) {
-          for (auto& kvp : m_pongs) {
-            auto ping = spawn<ping_actor>(buddy);
-            send(ping, atom("kickoff"), kvp.second, num_pings);
+  using pong_map = map<node, actor>;
+
+  server_actor(actor_config& cfg) : event_based_actor(cfg) {
+    // remove servers from the mesh when they go down instead of dying with
+    // them
+    set_exit_handler([=](const exit_msg& msg) {
+      auto i = find_if(pongs_.begin(), pongs_.end(),
+                       [&](const pong_map::value_type& kvp) {
+        return kvp.second.address() == msg.source;
+      });
+      if (i != pongs_.end())
+        pongs_.erase(i);
+    });
+    set_default_handler(print_and_drop);
+  }
+
+  behavior make_behavior() override {
+    return {
+      [=](ping_atom, uint32_t value, const string& payload) {
+        return make_tuple(pong_atom::value, value, payload);
+      },
+      [=](add_pong_atom, const string& host, uint16_t port) -> message {
+        auto key = make_pair(host, port);
+        if (pongs_.count(key) == 0) {
+          auto p = system().middleman().remote_actor(host, port);
+          if (!p)
+            return make_message(error_atom::value,
+                                system().render(p.error()));
+          link_to(*p);
+          pongs_.emplace(key, *p);
+        }
+        return make_message(ok_atom::value);
+      },
+      [=](kickoff_atom, uint32_t num_pings, const actor& buddy,
+          uint32_t node_id, uint32_t payload_size, uint32_t ping_actors) {
+        for (auto& kvp : pongs_) {
+          for (uint32_t i = 0; i < ping_actors; ++i) {
+            auto ping = spawn<ping_actor>(buddy, node_id, payload_size);
+            send(ping, kickoff_atom::value, kvp.second, num_pings);
           }
-        },
-        on(atom("purge")) >> [=] {
-            m_pongs.clear();
-        },
-        on<atom("EXIT"), uint32_t>() >> [=] {
-          auto who = current_sender();
-          auto i = find_if(m_pongs.begin(), m_pongs.end(),
-                           [&](const pong_map::value_type& kvp) {
-            return kvp.second == who;
-          });
-          if (i != m_pongs.end())
-            m_pongs.erase(i);
-        },
-        on(atom("shutdown")) >> [=] {
-          m_pongs.clear();
-          quit();
-        },
-        others >> [=] {
-          cout << "unexpected: " << to_string(current_message()) << endl;
         }
+      },
+      [=](stats_atom) {
+        wire_sample x;
+        add_tcp_stats(x);
+        s_syscalls.sample(x);
+        return make_message(x.bytes_out, x.bytes_in, x.segments_out,
+                            x.send_calls, x.recv_calls, s_syscalls.precise());
+      },
+      [=](purge_atom) {
+        pongs_.clear();
+      },
+      [=](shutdown_atom) {
+        pongs_.clear();
+        quit();
+      }
     };
   }
 
 private:
-  pong_map m_pongs;
+  pong_map pongs_;
 };
 
-template<typename Arg0>
-void usage(Arg0&& arg0) {
-  cout << forward<Arg0>(arg0) << endl << endl;
-  usage();
-}
+class my_config : public actor_system_config {
+public:
+  string mode;
+  int port = 0;
+  int num_pings = 0;
+  int nodes = 4;
+  int payload = 0;
+  int ping_actors = 1;
+  string wire_out;
 
-template<typename Arg0, typename Arg1, typename... Args>
-void usage(Arg0&& arg0, Arg1&& arg1, Args&&... args) {
-  cout << forward<Arg0>(arg0);
-  usage(forward<Arg1>(arg1), forward<Args>(args)...);
+  my_config() {
+    opt_group{custom_options_, "global"}
+      .add(mode, "mode,m", "set mode (server|benchmark|shutdown|cluster)")
+      .add(port, "port,p", "publish the server at port (0: any free port)")
+      .add(num_pings, "num-pings,n", "set number of pings per node pair")
+      .add(nodes, "nodes", "set number of local server processes (cluster)")
+      .add(payload, "payload", "set bytes carried by each ping and pong")
+      .add(ping_actors, "ping-actors",
+           "set number of concurrent ping actors per node pair")
+      .add(wire_out, "wire-out",
+           "append wire statistics as CSV line to file");
+  }
+};
+
+void usage() {
+  cout << "Running in server mode:"                                    << endl
+       << "  --mode=server  "                                          << endl
+       << "  --port=NUM       publishes an actor at port NUM"          << endl
+       << "  -p NUM           alias for --port=NUM"                    << endl
+       << endl
+       << endl
+       << "Running the benchmark:"                                     << endl
+       << "  --mode=benchmark run the benchmark, connect to any number"<< endl
+       << "                   of given servers, use HOST:PORT syntax"  << endl
+       << "  --num-pings=NUM  run benchmark with NUM messages per pair"<< endl
+       << "  --payload=BYTES  send BYTES of payload per ping and pong" << endl
+       << "  --ping-actors=NUM"                                        << endl
+       << "                   run NUM concurrent ping actors per pair" << endl
+       << "  --wire-out=FILE  append wire statistics as CSV to FILE"   << endl
+       << endl
+       << "  example: --mode=benchmark --num-pings=100 "
+                                        "192.168.9.1:1234 "
+                                        "192.168.9.2:1234"             << endl
+       << endl
+       << endl
+       << "Shutdown servers:"                                          << endl
+       << "  --mode=shutdown  shuts down any number of given servers"  << endl
+       << endl
+       << endl
+       << "Running the benchmark on a local cluster:"                  << endl
+       << "  --mode=cluster   forks servers on loopback, runs the"     << endl
+       << "                   benchmark and shuts the servers down"    << endl
+       << "  --nodes=NUM      number of server processes (default: 4)" << endl
+       << "  --num-pings=NUM  run benchmark with NUM messages per pair"<< endl
+       << endl
+       << endl
+       << "Miscellaneous:"                                             << endl
+       << "  -h, --help       print this text and exit"                << endl
+       << endl;
 }
 
-template<typename Iterator>
-void server_mode(Iterator first, Iterator last) {
-  string port_prefix = "--port=";
-  // extracts port from a key-value pair
-  auto kvp_port = [&](const string& str) -> maybe<int> {
-    if (equal(port_prefix.begin(), port_prefix.end(), str.begin())) {
-      return spro<int>(str.c_str() + port_prefix.size());
+// parses HOST:PORT arguments
+bool parse_nodes(const my_config& cfg, vector<node>& result) {
+  for (size_t i = 0; i < cfg.args_remainder.size(); ++i) {
+    auto arg = cfg.args_remainder.get_as<string>(i);
+    auto sep = arg.rfind(':');
+    int port = 0;
+    if (sep != string::npos)
+      port = atoi(arg.c_str() + sep + 1);
+    if (port <= 0 || port >= 65536) {
+      cerr << "expected HOST:PORT, got: " << arg << endl;
+      return false;
     }
-    return {};
-  };
-  message_builder{first, last}.apply({
-    (on(kvp_port) || on("-p", spro<int>)) >> [](int port) {
-      if (port > 1024 && port < 65536)
-        io::publish(spawn<server_actor>(), static_cast<uint16_t>(port));
-      else
-        usage("illegal port: ", port);
-    },
-    others >> [=] {
-      if (first != last) usage("illegal argument: ", *first);
-      else usage();
-    }
-  });
+    result.emplace_back(arg.substr(0, sep), static_cast<uint16_t>(port));
+  }
+  return true;
+}
+
+int server_mode(actor_system& system, const my_config& cfg) {
+  if (cfg.port < 0 || cfg.port >= 65536) {
+    cerr << "illegal port: " << cfg.port << endl;
+    return 1;
+  }
+  auto server = system.spawn<server_actor>();
+  auto port = system.middleman().publish(server,
+                                         static_cast<uint16_t>(cfg.port));
+  if (!port) {
+    cerr << "unable to publish server at port " << cfg.port << ": "
+         << system.render(port.error()) << endl;
+    anon_send_exit(server, exit_reason::user_shutdown);
+    return 1;
+  }
+  cout << "server published at port " << *port << endl;
+  return 0;
 }
 
-template<typename Iterator>
-void client_mode(Iterator first, Iterator last) {
-  if (first == last)
-    usage("no server, no fun");
-  uint32_t init_value = 0;
-  vector<pair<string, uint16_t> > remotes;
-  string pings_prefix = "--num_pings=";
-  auto num_msgs = [&](const string& str) -> maybe<int> {
-    if (equal(pings_prefix.begin(), pings_prefix.end(), str.begin())) {
-      return spro<int>(str.c_str() + pings_prefix.size());
+// returns the summed wire counters of all servers
+wire_sample query_wire_stats(scoped_actor& self, const vector<actor>& servers,
+                             bool& precise) {
+  wire_sample result;
+  for (auto& server : servers) {
+    self->request(server, infinite, stats_atom::value).receive(
+      [&](uint64_t bytes_out, uint64_t bytes_in, uint64_t segments_out,
+          uint64_t send_calls, uint64_t recv_calls, bool is_precise) {
+        result.bytes_out += bytes_out;
+        result.bytes_in += bytes_in;
+        result.segments_out += segments_out;
+        result.send_calls += send_calls;
+        result.recv_calls += recv_calls;
+        precise = precise && is_precise;
+      },
+      [&](error& err) {
+        cerr << "unable to query wire statistics: "
+             << self->system().render(err) << endl;
+        precise = false;
+      }
+    );
+  }
+  return result;
+}
+
+// pings between all pairs of `nodes` and prints throughput, latency and how
+// efficiently the middleman uses the wire
+int run_benchmark(actor_system& system, const vector<node>& nodes,
+                  const my_config& cfg) {
+  auto num_pings = cfg.num_pings;
+  if (num_pings <= 0) {
+    cerr << "no non-zero, non-negative init value given" << endl;
+    return 1;
+  }
+  if (nodes.size() < 2) {
+    cerr << "less than two nodes given" << endl;
+    return 1;
+  }
+  if (cfg.payload < 0 || cfg.ping_actors <= 0) {
+    cerr << "invalid payload size or number of ping actors" << endl;
+    return 1;
+  }
+  vector<actor> servers;
+  for (auto& n : nodes) {
+    auto x = system.middleman().remote_actor(n.first, n.second);
+    if (!x) {
+      cerr << "unable to connect to " << n.first << ":" << n.second << ": "
+           << system.render(x.error()) << endl;
+      return 1;
     }
-    return {};
+    servers.push_back(*x);
+  }
+  scoped_actor self{system};
+  auto purge_all = [&] {
+    for (auto& x : servers)
+      self->send(x, purge_atom::value);
   };
-  vector<string> vec;
-  for (auto i = first; i != last; ++i) {
-    vec.clear();
-    split(vec, *i, is_any_of(":"), token_compress_on);
-    message_builder{vec.begin(), vec.end()}.apply({
-      on(val<string>, spro<int>) >> [&](string& host, int port) {
-        if (port <= 1024 || port >= 65536) {
-          throw invalid_argument("illegal port: " + to_string(port));
-        }
-        remotes.emplace_back(move(host), static_cast<uint16_t>(port));
+  // setup phase: tell server nodes to connect to each other
+  for (size_t i = 0; i < nodes.size(); ++i)
+    for (size_t j = 0; j < nodes.size(); ++j)
+      if (i != j)
+        self->send(servers[i], add_pong_atom::value, nodes[j].first,
+                   nodes[j].second);
+  auto num_pairs = nodes.size() * (nodes.size() - 1);
+  bool setup_failed = false;
+  for (size_t i = 0; i < num_pairs && !setup_failed; ++i) {
+    self->receive(
+      [](ok_atom) {
+        // nop
+      },
+      [&](error_atom, const string& str) {
+        cerr << "error: " << str << endl;
+        setup_failed = true;
       },
-      on(num_msgs) >> [&](int num) {
-        if (num > 0) init_value = static_cast<uint32_t>(num);
+      after(std::chrono::seconds(10)) >> [&] {
+        cerr << "remote didn't answer within 10sec." << endl;
+        setup_failed = true;
       }
-    });
+    );
   }
-  if (init_value == 0) {
-      cout << "no non-zero, non-negative init value given" << endl;
-      exit(1);
-  }
-  if (remotes.size() < 2) {
-      cout << "less than two nodes given" << endl;
-      exit(1);
-  }
-  vector<actor> remote_actors;
-  for (auto& r : remotes) {
-      remote_actors.push_back(io::remote_actor(r.first.c_str(), r.second));
-  }
-  // setup phase
-  scoped_actor self;
-  //cout << "tell server nodes to connect to each other" << endl;
-  for (size_t i = 0; i < remotes.size(); ++i) {
-      for (size_t j = 0; j < remotes.size(); ++j) {
-          if (i != j) {
-              auto& r = remotes[j];
-              self->send(remote_actors[i], atom("add_pong"),
-                               r.first, r.second);
-          }
+  if (setup_failed) {
+    purge_all();
+    return 1;
+  }
+  // the difference to the counters after the run excludes connection setup
+  bool precise = true;
+  auto w0 = query_wire_stats(self, servers, precise);
+  // kickoff: every server pings every other server concurrently
+  auto t0 = hrc::now();
+  for (size_t i = 0; i < servers.size(); ++i)
+    self->send(servers[i], kickoff_atom::value,
+               static_cast<uint32_t>(num_pings), actor{self},
+               static_cast<uint32_t>(i), static_cast<uint32_t>(cfg.payload),
+               static_cast<uint32_t>(cfg.ping_actors));
+  // pings sent, sum of their RTTs and the time until the last ping actor
+  // finished per node
+  struct node_stats {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t elapsed = 0;
+  };
+  vector<node_stats> per_node(nodes.size());
+  uint64_t total_count = 0;
+  uint64_t total_sum = 0;
+  uint64_t max_rtt = 0;
+  uint64_t worst_p99 = 0;
+  vector<uint64_t> medians;
+  auto num_ping_actors = num_pairs * static_cast<size_t>(cfg.ping_actors);
+  for (size_t i = 0; i < num_ping_actors; ++i) {
+    self->receive(
+      [&](done_atom, uint32_t node_id, uint64_t count, uint64_t sum,
+          uint64_t p50, uint64_t p99, uint64_t max, uint64_t elapsed) {
+        auto& ns = per_node[node_id];
+        ns.count += count;
+        ns.sum += sum;
+        ns.elapsed = std::max(ns.elapsed, elapsed);
+        total_count += count;
+        total_sum += sum;
+        medians.push_back(p50);
+        worst_p99 = std::max(worst_p99, p99);
+        max_rtt = std::max(max_rtt, max);
       }
+    );
   }
-  { // collect {ok} messages
-      size_t i = 0;
-      size_t end = remote_actors.size() * (remote_actors.size() - 1);
-      self->receive_for(i, end) (
-          on(atom("ok")) >> [] {
-              // nothing to do
-          },
-          on(atom("error"), arg_match) >> [&](const string& str) {
-              cout << "error: " << str << endl;
-              for (auto& x : remote_actors) {
-                  self->send(x, atom("purge"));
-              }
-              throw logic_error("");
-          },
-          others >> [&] {
-              cout << "expected {ok|error}, received: "
-                   << to_string(self->current_message())
-                   << endl;
-              throw logic_error("");
-          },
-          after(chrono::seconds(10)) >> [&] {
-              cout << "remote didn't answer within 10sec." << endl;
-              for (auto& x : remote_actors) {
-                  self->send(x, atom("purge"));
-              }
-              throw logic_error("");
-          }
-      );
-  }
-  // kickoff
-  //cout << "setup done" << endl;
-  //cout << "kickoff, init value = " << init_value << endl;
-  for (auto& r : remote_actors) {
-      self->send(r, atom("kickoff"), init_value, self);
-  }
-  { // collect {done} messages
-      size_t i = 0;
-      size_t end = remote_actors.size() * (remote_actors.size() - 1);
-      self->receive_for(i, end) (
-          on(atom("done")) >> [] {
-              //cout << "...done..." << endl;
-          },
-          others >> [&] {
-              cout << "unexpected: "
-                   << to_string(self->current_message()) << endl;
-              throw logic_error("");
-          }
-      );
+  auto t1 = hrc::now();
+  auto w1 = query_wire_stats(self, servers, precise);
+  purge_all();
+  auto seconds = std::chrono::duration<double>(t1 - t0).count();
+  std::sort(medians.begin(), medians.end());
+  auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+  cout << "nodes: " << nodes.size() << ", pairs: " << num_pairs
+       << ", ping actors per pair: " << cfg.ping_actors
+       << ", payload: " << cfg.payload << " bytes"
+       << ", pings: " << total_count << endl
+       << "pings/s: " << static_cast<double>(total_count) / seconds << endl
+       << "rtt (us): mean "
+       << us(total_sum) / static_cast<double>(total_count)
+       << ", median p50 " << us(medians[medians.size() / 2])
+       << ", worst p99 " << us(worst_p99)
+       << ", max " << us(max_rtt) << endl;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    auto& ns = per_node[i];
+    cout << "node " << i << " (" << nodes[i].first << ":" << nodes[i].second
+         << "): pings " << ns.count << ", pings/s "
+         << static_cast<double>(ns.count) / (us(ns.elapsed) / 1e6)
+         << ", mean rtt (us) "
+         << us(ns.sum) / static_cast<double>(ns.count) << endl;
+  }
+  // every ping and every pong crosses the wire once; bytes and segments
+  // are counted at the sending socket only, the few control messages from
+  // and to this client are included
+  auto messages = static_cast<double>(2 * total_count);
+  auto per_msg = [&](uint64_t before, uint64_t after) {
+    return static_cast<double>(after - before) / messages;
+  };
+  // IPv4 + TCP header with timestamp option, no link layer
+  constexpr double tcp_ip_header_size = 52;
+  auto stream_bytes = per_msg(w0.bytes_out, w1.bytes_out);
+  auto segments = per_msg(w0.segments_out, w1.segments_out);
+  auto sends = per_msg(w0.send_calls, w1.send_calls);
+  auto recvs = per_msg(w0.recv_calls, w1.recv_calls);
+  auto batching = sends > 0 ? 1.0 / sends : 0.0;
+  cout << "wire per message: " << stream_bytes << " stream bytes, "
+       << segments << " segments, "
+       << stream_bytes + segments * tcp_ip_header_size
+       << " bytes incl. TCP/IP headers" << endl;
+  if (precise)
+    cout << "syscalls per message: " << sends << " send, " << recvs
+         << " recv, batching: " << batching << " messages per send" << endl;
+  else
+    cout << "syscalls per message: n/a (no syscall tracepoints on all nodes)"
+         << endl;
+  if (!cfg.wire_out.empty()) {
+    ifstream existing{cfg.wire_out};
+    auto empty = !existing || existing.peek() == ifstream::traits_type::eof();
+    ofstream out{cfg.wire_out, std::ios::app};
+    if (empty)
+      out << "payload,ping_actors,pings_per_s,mean_rtt_us,stream_bytes_per_msg,"
+             "segments_per_msg,wire_bytes_per_msg,sends_per_msg,recvs_per_msg,"
+             "msgs_per_send,precise" << endl;
+    out << cfg.payload << "," << cfg.ping_actors << ","
+        << static_cast<double>(total_count) / seconds << ","
+        << us(total_sum) / static_cast<double>(total_count) << ","
+        << stream_bytes << "," << segments << ","
+        << stream_bytes + segments * tcp_ip_header_size << ",";
+    // leave syscall columns empty rather than writing meaningless numbers
+    if (precise)
+      out << sends << "," << recvs << "," << batching << ",1" << endl;
+    else
+      out << ",,,0" << endl;
   }
+  return 0;
 }
 
-template<typename Iterator>
-void shutdown_mode(Iterator first, Iterator last) {
-  vector<pair<string, uint16_t> > remotes;
-
+int client_mode(actor_system& system, const my_config& cfg) {
+  vector<node> nodes;
+  if (!parse_nodes(cfg, nodes))
+    return 1;
+  return run_benchmark(system, nodes, cfg);
+}
 
-  vector<string> vec;
-  for (auto i = first; i != last; ++i) {
-    vec.clear();
-    split(vec, *i, is_any_of(":"), token_compress_on);
-    message_builder{vec.begin(), vec.end()}.apply({
-      on(val<string>, spro<int>) >> [&](string& host, int port) {
-        if (port <= 1024 || port >= 65536) {
-          throw invalid_argument("illegal port: " + to_string(port));
-        }
-        remotes.emplace_back(move(host), static_cast<uint16_t>(port));
+int shutdown_nodes(actor_system& system, const vector<node>& nodes) {
+  scoped_actor self{system};
+  int result = 0;
+  for (auto& n : nodes) {
+    auto x = system.middleman().remote_actor(n.first, n.second);
+    if (!x) {
+      cerr << "couldn't shutdown " << n.first << ":" << n.second
+           << "; reason: " << system.render(x.error()) << endl;
+      result = 1;
+      continue;
+    }
+    self->monitor(*x);
+    self->send(*x, shutdown_atom::value);
+    self->receive(
+      [](const down_msg&) {
+        // ok, done
+      },
+      after(std::chrono::seconds(10)) >> [&] {
+        cerr << n.first << ":" << n.second << " didn't shut down "
+             << "within 10s" << endl;
+        result = 1;
       }
-    });
+    );
   }
-  scoped_actor self;
-  for (auto& r : remotes) {
-    try {
-      auto x = io::remote_actor(r.first, r.second);
-      self->monitor(x);
-      self->send(x, atom("shutdown"));
-      self->receive (
-        on(atom("DOWN"), val<uint32_t>) >> [] {
-          // ok, done
-        },
-        after(chrono::seconds(10)) >> [&] {
-          cerr << r.first << ":" << r.second << " didn't shut down "
-               << "within 10s"
-               << endl;
-        }
-      );
+  return result;
+}
+
+int shutdown_mode(actor_system& system, const my_config& cfg) {
+  vector<node> nodes;
+  if (!parse_nodes(cfg, nodes))
+    return 1;
+  return shutdown_nodes(system, nodes);
+}
+
+// returns the i-th of n disjoint, contiguous chunks of `cpus` or a single
+// CPU (round-robin) if there are more nodes than CPUs
+vector<int> node_cpus(const vector<int>& cpus, size_t i, size_t n) {
+  if (cpus.empty())
+    return {};
+  if (n >= cpus.size())
+    return {cpus[i % cpus.size()]};
+  return {cpus.begin() + static_cast<ptrdiff_t>(i * cpus.size() / n),
+          cpus.begin() + static_cast<ptrdiff_t>((i + 1) * cpus.size() / n)};
+}
+
+// runs in a forked child: starts a server pinned to `cpus` on loopback,
+// writes its port to `fd` and returns after the server got shut down
+int cluster_node(my_config& cfg, const vector<int>& cpus, int fd,
+                 thread_placement& placement) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus)
+    CPU_SET(cpu, &set);
+  // the scheduler threads inherit the mask of the main thread
+  if (!cpus.empty() && sched_setaffinity(0, sizeof(set), &set) != 0)
+    perror("sched_setaffinity");
+  if (!cpus.empty())
+    cfg.scheduler_max_threads = cpus.size();
+  s_syscalls.open();
+  // places threads within the CPUs of this node
+  placement.prepare();
+  actor_system system{cfg};
+  placement.apply(cfg.scheduler_max_threads);
+  auto server = system.spawn<server_actor>();
+  auto port = system.middleman().publish(server, 0, "127.0.0.1");
+  if (!port) {
+    cerr << "unable to publish server: " << system.render(port.error())
+         << endl;
+    anon_send_exit(server, exit_reason::user_shutdown);
+    return 1;
+  }
+  auto value = *port;
+  if (write(fd, &value, sizeof(value)) != sizeof(value)) {
+    anon_send_exit(server, exit_reason::user_shutdown);
+    return 1;
+  }
+  close(fd);
+  return 0;
+}
+
+// forks `cfg.nodes` servers, runs the benchmark against them and shuts them
+// down again; must run before this process starts any thread
+int cluster_mode(my_config& cfg, thread_placement& placement) {
+  if (cfg.nodes < 2) {
+    cerr << "less than two nodes given" << endl;
+    return 1;
+  }
+  auto num_nodes = static_cast<size_t>(cfg.nodes);
+  auto cpus = topology::local().cpu_ids();
+  vector<pid_t> children;
+  vector<node> nodes;
+  auto wait_for_children = [&]() -> int {
+    int result = 0;
+    for (auto pid : children) {
+      int status = 0;
+      if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)
+          || WEXITSTATUS(status) != 0) {
+        cerr << "node with PID " << pid << " did not exit cleanly" << endl;
+        result = 1;
+      }
+    }
+    return result;
+  };
+  for (size_t i = 0; i < num_nodes; ++i) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      perror("pipe");
+      abort();
     }
-    catch (std::exception& e) {
-      cerr << "couldn't shutdown " << r.first << ":" << r.second
-           << "; reason: " << e.what()
-           << endl;
+    auto pin = node_cpus(cpus, i, num_nodes);
+    auto pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      abort();
     }
+    if (pid == 0) {
+      close(fds[0]);
+      _exit(cluster_node(cfg, pin, fds[1], placement));
+    }
+    close(fds[1]);
+    children.push_back(pid);
+    uint16_t port = 0;
+    auto n = read(fds[0], &port, sizeof(port));
+    close(fds[0]);
+    if (n != sizeof(port)) {
+      cerr << "node " << i << " failed to start" << endl;
+      for (auto child : children)
+        kill(child, SIGTERM);
+      wait_for_children();
+      return 1;
+    }
+    cout << "node " << i << ": 127.0.0.1:" << port << ", CPUs";
+    for (auto cpu : pin)
+      cout << " " << cpu;
+    cout << endl;
+    nodes.emplace_back("127.0.0.1", port);
   }
+  int result;
+  { // scope for the actor system of the client
+    actor_system system{cfg};
+    result = run_benchmark(system, nodes, cfg);
+    if (shutdown_nodes(system, nodes) != 0)
+      result = 1;
+  }
+  if (wait_for_children() != 0)
+    result = 1;
+  return result;
+}
+
+int run(actor_system& system, const my_config& cfg) {
+  if (cfg.mode == "server")
+    return server_mode(system, cfg);
+  if (cfg.mode == "benchmark")
+    return client_mode(system, cfg);
+  if (cfg.mode == "shutdown")
+    return shutdown_mode(system, cfg);
+  usage();
+  return cfg.mode.empty() ? 0 : 1;
 }
 
 } // namespace <anonymous>
 
 int main(int argc, char** argv) {
-    if (argc < 2) usage();
-    auto first = argv + 1;
-    auto last = argv + argc;
-    message_builder{first, first + 1}.apply({
-      on("mode=server") >> [=] {
-        server_mode(first + 1, last);
-      },
-      on("mode=benchmark") >> [=] {
-        client_mode(first + 1, last);
-      },
-      on("mode=shutdown") >> [=] {
-        shutdown_mode(first + 1, last);
-      },
-      (on("-h") || on("--help")) >> [] {
-        usage();
-      },
-      others >> [=] {
-        usage("unknown argument: ", *first);
-      }
-    });
-    await_all_actors_done();
-    shutdown();
+  auto placement = thread_placement::from_args(argc, argv);
+  my_config cfg;
+  cfg.load<io::middleman>();
+  cfg.scheduler_max_threads = topology::local().usable_cpus();
+  cfg.parse(argc, argv, "caf-application.ini");
+  if (cfg.cli_helptext_printed)
+    return 0;
+  // fork the servers before any actor system starts threads
+  if (cfg.mode == "cluster")
+    return cluster_mode(cfg, placement);
+  if (cfg.mode == "server")
+    s_syscalls.open();
+  placement.prepare();
+  actor_system system{cfg};
+  placement.apply(cfg.scheduler_max_threads);
+  return run(system, cfg);
 }
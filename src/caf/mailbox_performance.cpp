@@ -24,6 +24,9 @@
 
 #include "caf/all.hpp"
 
+#include "topology.hpp"
+#include "placement.hpp"
+
 using namespace std;
 using namespace caf;
 
@@ -66,11 +69,15 @@ int usage() {
               << endl << endl, 1;
 }
 
-void run(int argc, char** argv, uint64_t num_sender, uint64_t num_msgs) {
+void run(int argc, char** argv, thread_placement& placement,
+         uint64_t num_sender, uint64_t num_msgs) {
   auto total = num_sender * num_msgs;
   actor_system_config cfg;
+  cfg.scheduler_max_threads = topology::local().usable_cpus();
   cfg.parse(argc, argv, "caf-application.ini");
+  placement.prepare();
   actor_system system{cfg};
+  placement.apply(cfg.scheduler_max_threads);
   auto testee = system.spawn<receiver>(total);
   for (uint64_t i = 0; i < num_sender; ++i)
     system.spawn(sender, testee, num_msgs);
@@ -79,8 +86,9 @@ void run(int argc, char** argv, uint64_t num_sender, uint64_t num_msgs) {
 } // namespace <anonymous>
 
 int main(int argc, char** argv) {
+  auto placement = thread_placement::from_args(argc, argv);
   if (argc != 3)
     return usage();
-  run(argc, argv, static_cast<uint64_t>(stoll(argv[1])),
+  run(argc, argv, placement, static_cast<uint64_t>(stoll(argv[1])),
       static_cast<uint64_t>(stoll(argv[2])));
 }
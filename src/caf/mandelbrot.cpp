@@ -1,26 +1,350 @@
 #include <cstdio>
 #include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 
+#include <string>
 #include <vector>
 #include <iostream>
 
 #include "caf/all.hpp"
 
+#include "topology.hpp"
+#include "placement.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define MANDELBROT_X86_KERNELS
+# include <immintrin.h>
+#endif
+
 typedef unsigned char byte;
 
 using namespace std;
 using namespace caf;
 
+namespace {
+
+constexpr size_t max_iterations = 250;
+constexpr double limit          = 2.0;
+constexpr double limit_sq       = limit * limit;
+
+// Computes 8 pixels of a row starting at `cr0_x` and returns them as PBM bits.
+// All kernels must produce bit-identical results, which also means the
+// compiler must not contract `a * b + c` into an FMA (see CMakeLists.txt).
+using kernel = byte (*)(const double* cr0_x, double ci0);
+
+byte scalar_kernel(const double* cr0_x, double ci0) {
+  double cr[8];
+  double ci[8];
+  for (int k = 0; k < 8; ++k) {
+      cr[k] = cr0_x[k];
+      ci[k] = ci0;
+  }
+  byte bits = 0xFF;
+  for (size_t i = 0; bits && i < max_iterations; ++i) {
+    byte bit_k = 0x80;
+    for (int k = 0; k < 8; ++k) {
+      if (bits & bit_k) {
+        const double cr_k    = cr[k];
+        const double ci_k    = ci[k];
+        const double cr_k_sq = cr_k * cr_k;
+        const double ci_k_sq = ci_k * ci_k;
+        cr[k] = cr_k_sq - ci_k_sq + cr0_x[k];
+        ci[k] = 2.0 * cr_k * ci_k + ci0;
+        if (cr_k_sq + ci_k_sq > limit_sq) {
+          bits ^= bit_k;
+        }
+      }
+      bit_k >>= 1;
+    }
+  }
+  return bits;
+}
+
+#ifdef MANDELBROT_X86_KERNELS
+
+// SIMD kernels keep iterating escaped lanes instead of branching per lane;
+// their values are never looked at again, so the output stays identical
+
+// maps a lane mask (bit k = lane k) to PBM bit order (lane 0 = MSB)
+inline byte to_pbm_bits(unsigned lanes) {
+  byte result = 0;
+  for (int k = 0; k < 8; ++k)
+    if (lanes & (1u << k))
+      result |= static_cast<byte>(0x80 >> k);
+  return result;
+}
+
+__attribute__((target("sse2")))
+byte sse2_kernel(const double* cr0_x, double ci0) {
+  const __m128d ci0_v = _mm_set1_pd(ci0);
+  const __m128d two = _mm_set1_pd(2.0);
+  const __m128d lim = _mm_set1_pd(limit_sq);
+  __m128d cr0[4];
+  __m128d cr[4];
+  __m128d ci[4];
+  for (int j = 0; j < 4; ++j) {
+    cr0[j] = _mm_loadu_pd(cr0_x + 2 * j);
+    cr[j] = cr0[j];
+    ci[j] = ci0_v;
+  }
+  unsigned lanes = 0xFF;
+  for (size_t i = 0; lanes && i < max_iterations; ++i) {
+    unsigned escaped = 0;
+    for (int j = 0; j < 4; ++j) {
+      const __m128d cr_sq = _mm_mul_pd(cr[j], cr[j]);
+      const __m128d ci_sq = _mm_mul_pd(ci[j], ci[j]);
+      const __m128d abs_sq = _mm_add_pd(cr_sq, ci_sq);
+      ci[j] = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(two, cr[j]), ci[j]), ci0_v);
+      cr[j] = _mm_add_pd(_mm_sub_pd(cr_sq, ci_sq), cr0[j]);
+      auto mask = _mm_movemask_pd(_mm_cmpgt_pd(abs_sq, lim));
+      escaped |= static_cast<unsigned>(mask) << (2 * j);
+    }
+    lanes &= ~escaped;
+  }
+  return to_pbm_bits(lanes);
+}
+
+__attribute__((target("avx2")))
+byte avx2_kernel(const double* cr0_x, double ci0) {
+  const __m256d ci0_v = _mm256_set1_pd(ci0);
+  const __m256d two = _mm256_set1_pd(2.0);
+  const __m256d lim = _mm256_set1_pd(limit_sq);
+  __m256d cr0[2];
+  __m256d cr[2];
+  __m256d ci[2];
+  for (int j = 0; j < 2; ++j) {
+    cr0[j] = _mm256_loadu_pd(cr0_x + 4 * j);
+    cr[j] = cr0[j];
+    ci[j] = ci0_v;
+  }
+  unsigned lanes = 0xFF;
+  for (size_t i = 0; lanes && i < max_iterations; ++i) {
+    unsigned escaped = 0;
+    for (int j = 0; j < 2; ++j) {
+      const __m256d cr_sq = _mm256_mul_pd(cr[j], cr[j]);
+      const __m256d ci_sq = _mm256_mul_pd(ci[j], ci[j]);
+      const __m256d abs_sq = _mm256_add_pd(cr_sq, ci_sq);
+      ci[j] = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, cr[j]), ci[j]),
+                            ci0_v);
+      cr[j] = _mm256_add_pd(_mm256_sub_pd(cr_sq, ci_sq), cr0[j]);
+      auto mask = _mm256_movemask_pd(_mm256_cmp_pd(abs_sq, lim, _CMP_GT_OQ));
+      escaped |= static_cast<unsigned>(mask) << (4 * j);
+    }
+    lanes &= ~escaped;
+  }
+  return to_pbm_bits(lanes);
+}
+
+__attribute__((target("avx512f")))
+byte avx512_kernel(const double* cr0_x, double ci0) {
+  const __m512d ci0_v = _mm512_set1_pd(ci0);
+  const __m512d two = _mm512_set1_pd(2.0);
+  const __m512d lim = _mm512_set1_pd(limit_sq);
+  const __m512d cr0 = _mm512_loadu_pd(cr0_x);
+  __m512d cr = cr0;
+  __m512d ci = ci0_v;
+  unsigned lanes = 0xFF;
+  for (size_t i = 0; lanes && i < max_iterations; ++i) {
+    const __m512d cr_sq = _mm512_mul_pd(cr, cr);
+    const __m512d ci_sq = _mm512_mul_pd(ci, ci);
+    const __m512d abs_sq = _mm512_add_pd(cr_sq, ci_sq);
+    ci = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, cr), ci), ci0_v);
+    cr = _mm512_add_pd(_mm512_sub_pd(cr_sq, ci_sq), cr0);
+    lanes &= ~static_cast<unsigned>(_mm512_cmp_pd_mask(abs_sq, lim,
+                                                       _CMP_GT_OQ));
+  }
+  return to_pbm_bits(lanes);
+}
+
+#endif // MANDELBROT_X86_KERNELS
+
+// returns the best kernel supported by this CPU for `name == "auto"`
+kernel select_kernel(const string& name) {
+#ifdef MANDELBROT_X86_KERNELS
+  __builtin_cpu_init();
+  auto is_auto = name == "auto";
+  if ((is_auto || name == "avx512") && __builtin_cpu_supports("avx512f"))
+    return avx512_kernel;
+  if ((is_auto || name == "avx2") && __builtin_cpu_supports("avx2"))
+    return avx2_kernel;
+  if ((is_auto || name == "sse2") && __builtin_cpu_supports("sse2"))
+    return sse2_kernel;
+#endif // MANDELBROT_X86_KERNELS
+  if (name == "auto" || name == "scalar")
+    return scalar_kernel;
+  return nullptr;
+}
+
+// Adler-32 as specified in RFC 1950, all implementations of this benchmark
+// print it for the PBM pixel data with padding bits of each row cleared
+uint32_t adler32(const byte* data, size_t size) {
+  constexpr uint32_t mod = 65521;
+  constexpr size_t max_chunk = 5552; // largest n such that b cannot overflow
+  uint32_t a = 1;
+  uint32_t b = 0;
+  while (size > 0) {
+    auto n = min(size, max_chunk);
+    size -= n;
+    for (; n > 0; --n) {
+      a += *data++;
+      b += a;
+    }
+    a %= mod;
+    b %= mod;
+  }
+  return (b << 16) | a;
+}
+
+// writes a P4 file with a single system call
+bool write_pbm(const string& path, size_t width, size_t height,
+               const vector<byte>& buffer) {
+  auto header = "P4\n" + to_string(width) + " " + to_string(height) + "\n";
+  iovec iov[2];
+  iov[0].iov_base = &header[0];
+  iov[0].iov_len = header.size();
+  iov[1].iov_base = const_cast<byte*>(buffer.data());
+  iov[1].iov_len = buffer.size();
+  auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+  auto res = writev(fd, iov, 2);
+  close(fd);
+  return res == static_cast<ssize_t>(header.size() + buffer.size());
+}
+
+using pull_atom = atom_constant<atom("pull")>;
+using work_atom = atom_constant<atom("work")>;
+using done_atom = atom_constant<atom("done")>;
+
+// a rectangle of the image, columns are counted in bytes (8 pixels each)
+struct work_unit {
+  size_t first_row;
+  size_t last_row; // exclusive
+  size_t first_col;
+  size_t last_col; // exclusive
+};
+
+struct image {
+  byte* buffer;
+  const double* cr0;
+  size_t height;
+  size_t max_x;
+  kernel calc;
+};
+
+void render(const image& img, const work_unit& unit) {
+  for (size_t y = unit.first_row; y < unit.last_row; ++y) {
+    byte* line = img.buffer + y * img.max_x;
+    const double ci0 = 2.0 * y / img.height - 1.0;
+    for (size_t x = unit.first_col; x < unit.last_col; ++x)
+      line[x] = img.calc(img.cr0 + 8 * x, ci0);
+  }
+}
+
+// splits the image into blocks of `grain` full rows or, if `tile` is not 0,
+// into square tiles of `tile` x `tile` pixels (rounded up to full bytes)
+vector<work_unit> make_work_units(size_t height, size_t max_x, size_t grain,
+                                  size_t tile) {
+  vector<work_unit> result;
+  auto rows = tile > 0 ? tile : max(grain, size_t{1});
+  auto cols = tile > 0 ? (tile + 7) / 8 : max_x;
+  for (size_t y = 0; y < height; y += rows)
+    for (size_t x = 0; x < max_x; x += cols)
+      result.push_back(work_unit{y, min(y + rows, height),
+                                 x, min(x + cols, max_x)});
+  return result;
+}
+
+// hands out work units to workers on request until none is left
+class coordinator : public event_based_actor {
+public:
+  coordinator(actor_config& cfg, size_t num_units, size_t num_workers)
+      : event_based_actor(cfg),
+        next_(0),
+        num_units_(num_units),
+        num_workers_(num_workers) {
+    // nop
+  }
+
+  behavior make_behavior() override {
+    return {
+      [=](pull_atom) -> message {
+        if (next_ < num_units_)
+          return make_message(work_atom::value, uint64_t{next_++});
+        if (--num_workers_ == 0)
+          quit();
+        return make_message(done_atom::value);
+      }
+    };
+  }
+
+private:
+  size_t next_;
+  size_t num_units_;
+  size_t num_workers_;
+};
+
+behavior pulling_worker(event_based_actor* self, const image* img,
+                        const vector<work_unit>* units, actor parent) {
+  self->send(parent, pull_atom::value);
+  return {
+    [=](work_atom, uint64_t i) {
+      render(*img, (*units)[i]);
+      return pull_atom::value;
+    },
+    [=](done_atom) {
+      self->quit();
+    }
+  };
+}
+
+class my_config : public actor_system_config {
+public:
+  string kernel_name = "auto";
+  int grain = 1;
+  int tile = 0;
+  bool dynamic = false;
+  int workers = 0;
+  string pbm_file;
+
+  my_config() {
+    opt_group{custom_options_, "global"}
+      .add(kernel_name, "kernel",
+           "select kernel: auto (default), scalar, sse2, avx2 or avx512")
+      .add(grain, "grain", "set number of rows per work unit (default: 1)")
+      .add(tile, "tile", "use square tiles of N x N pixels as work units")
+      .add(dynamic, "dynamic",
+           "let workers pull work units from a coordinator instead of "
+           "spawning one actor per unit")
+      .add(workers, "workers",
+           "set number of workers for --dynamic (default: scheduler threads)")
+      .add(pbm_file, "pbm", "write the image to file in PBM format");
+  }
+};
+
+} // namespace <anonymous>
+
 int main(int argc, char* argv[]) {
-  if (argc != 2)
-    return cout << "usage: ./" << argv[0] << " N" << endl, 1;
-  const size_t N              = static_cast<size_t>(atoi(argv[1]));
+  auto placement = thread_placement::from_args(argc, argv);
+  my_config cfg;
+  cfg.scheduler_max_threads = topology::local().usable_cpus();
+  cfg.parse(argc, argv, "caf-application.ini");
+  if (cfg.args_remainder.size() != 1 || cfg.grain < 1 || cfg.tile < 0)
+    return cout << "usage: ./" << argv[0] << " N [--kernel=NAME]"
+                   " [--grain=ROWS|--tile=PIXELS] [--dynamic [--workers=N]]"
+                   " [--pbm=FILE] [--pin=POLICY] [--numa-mem=POLICY]"
+                << endl, 1;
+  auto calc = select_kernel(cfg.kernel_name);
+  if (calc == nullptr)
+    return cerr << "kernel not available: " << cfg.kernel_name << endl, 1;
+  const size_t N              = static_cast<size_t>(
+                                  atoi(cfg.args_remainder.get_as<string>(0)
+                                         .c_str()));
   const size_t width          = N;
   const size_t height         = N;
   const size_t max_x          = (width + 7) / 8;
-  const size_t max_iterations = 250;
-  const double limit          = 2.0;
-  const double limit_sq       = limit * limit;
   vector<byte> buffer(height * max_x);
   vector<double> cr0(8 * max_x);
   for (size_t x = 0; x < max_x; ++x) {
@@ -29,47 +353,33 @@ int main(int argc, char* argv[]) {
       cr0[xk] = (2.0 * xk) / width - 1.5;
     }
   }
-  actor_system_config cfg;
-  actor_system system{cfg};
-  for (size_t y = 0; y < height; ++y) {
-    byte* line = &buffer[y * max_x];
-    system.spawn([=] {
-      const double ci0 = 2.0 * y / height - 1.0;
-      for (size_t x = 0; x < max_x; ++x) {
-        const double* cr0_x = &cr0[8 * x];
-        double cr[8];
-        double ci[8];
-        for (int k = 0; k < 8; ++k) {
-            cr[k] = cr0_x[k];
-            ci[k] = ci0;
-        }
-        byte bits = 0xFF;
-        for (size_t i = 0; bits && i < max_iterations; ++i) {
-          byte bit_k = 0x80;
-          for (int k = 0; k < 8; ++k) {
-            if (bits & bit_k) {
-              const double cr_k    = cr[k];
-              const double ci_k    = ci[k];
-              const double cr_k_sq = cr_k * cr_k;
-              const double ci_k_sq = ci_k * ci_k;
-              cr[k] = cr_k_sq - ci_k_sq + cr0_x[k];
-              ci[k] = 2.0 * cr_k * ci_k + ci0;
-              if (cr_k_sq + ci_k_sq > limit_sq) {
-                bits ^= bit_k;
-              }
-            }
-            bit_k >>= 1;
-          }
-        }
-        line[x] = bits;
-      }
-    });
+  const image img{buffer.data(), cr0.data(), height, max_x, calc};
+  const auto units = make_work_units(height, max_x,
+                                     static_cast<size_t>(cfg.grain),
+                                     static_cast<size_t>(cfg.tile));
+  { // lifetime scope of the actor system, waits for all actors on exit
+    placement.prepare();
+    actor_system system{cfg};
+    placement.apply(cfg.scheduler_max_threads);
+    if (cfg.dynamic) {
+      auto num_workers = cfg.workers > 0 ? static_cast<size_t>(cfg.workers)
+                                         : cfg.scheduler_max_threads;
+      auto parent = system.spawn<coordinator>(units.size(), num_workers);
+      for (size_t i = 0; i < num_workers; ++i)
+        system.spawn(pulling_worker, &img, &units, parent);
+    } else {
+      for (auto& unit : units)
+        system.spawn([&img, unit] { render(img, unit); });
+    }
+  }
+  // PBM ignores padding bits but other implementations leave them zeroed
+  if (width % 8 != 0) {
+    auto mask = static_cast<byte>(0xFF << (8 - width % 8));
+    for (size_t y = 0; y < height; ++y)
+      buffer[y * max_x + max_x - 1] &= mask;
   }
-  //FILE* out = (argc == 3) ? fopen(argv[2], "wb") : stdout;
-  //fprintf(out, "P4\n%u %u\n", width, height);
-  //fwrite(&buffer[0], buffer.size(), 1, out);
-  //if (out != stdout) {
-  //  fclose(out);
-  //}
+  cout << "checksum: " << adler32(buffer.data(), buffer.size()) << endl;
+  if (!cfg.pbm_file.empty() && !write_pbm(cfg.pbm_file, width, height, buffer))
+    return cerr << "unable to write " << cfg.pbm_file << endl, 1;
   return 0;
 }
@@ -17,53 +17,119 @@
  * http://www.boost.org/LICENSE_1_0.txt.                                      *
  ******************************************************************************/
 
+#include <map>
 #include <array>
+#include <cmath>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <thread>
 #include <vector>
 #include <future>
+#include <cstdlib>
 #include <numeric>
+#include <sstream>
+#include <iomanip>
 #include <iostream>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
 
 #include "caf/all.hpp"
 
+#include "topology.hpp"
+#include "placement.hpp"
+
 #ifdef ENABLE_OPENCL
 #include "caf/opencl/all.hpp"
 #endif
 
+#ifdef __GNUC__
+# define MATRIX_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+# define MATRIX_ALWAYS_INLINE inline
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define MATRIX_X86_KERNELS
+# include <immintrin.h>
+#endif
+
 using namespace std;
 using namespace caf;
 
-static constexpr size_t matrix_size = 1000;
+// keeps rows of matrices with a dimension divisible by 16 cache line aligned
+template <class T>
+struct aligned_allocator {
+  using value_type = T;
+
+  static constexpr size_t alignment = 64;
+
+  aligned_allocator() = default;
+
+  template <class U>
+  aligned_allocator(const aligned_allocator<U>&) {
+    // nop
+  }
+
+  T* allocate(size_t n) {
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, n * sizeof(T)) != 0)
+      throw std::bad_alloc();
+    return static_cast<T*>(ptr);
+  }
+
+  void deallocate(T* ptr, size_t) {
+    free(ptr);
+  }
+};
+
+template <class T, class U>
+bool operator==(const aligned_allocator<T>&, const aligned_allocator<U>&) {
+  return true;
+}
+
+template <class T, class U>
+bool operator!=(const aligned_allocator<T>&, const aligned_allocator<U>&) {
+  return false;
+}
 
-template <size_t Size>
 class square_matrix {
 public:
-  static constexpr size_t num_elements = Size * Size;
-
   using value_type = float;
 
+  using storage = vector<float, aligned_allocator<float>>;
+
   square_matrix(square_matrix&&) = default;
   square_matrix(const square_matrix&) = default;
   square_matrix& operator=(square_matrix&&) = default;
   square_matrix& operator=(const square_matrix&) = default;
 
-  square_matrix() {
-    data_.resize(num_elements);
-  }
-
-  square_matrix(vector<float> d) : data_(std::move(d)) {
+  square_matrix() : dim_(0) {
     // nop
   }
 
-  square_matrix(const std::initializer_list<float>& args) : data_(args) {
-    data_.resize(num_elements);
+  explicit square_matrix(size_t dim) : dim_(dim), data_(dim * dim) {
+    // nop
   }
 
   inline float& operator()(size_t row, size_t column) {
-    return data_[row * Size + column];
+    return data_[row * dim_ + column];
   }
 
   inline const float& operator()(size_t row, size_t column) const {
-    return data_[row * Size + column];
+    return data_[row * dim_ + column];
+  }
+
+  inline size_t dim() const {
+    return dim_;
+  }
+
+  inline size_t num_elements() const {
+    return data_.size();
   }
 
   inline void zeroize() {
@@ -74,7 +140,7 @@ public:
     std::iota(data_.begin(), data_.end(), 0);
   }
 
-  typedef typename vector<float>::const_iterator const_iterator;
+  typedef storage::const_iterator const_iterator;
 
   const_iterator begin() const {
     return data_.begin();
@@ -84,74 +150,328 @@ public:
     return data_.end();
   }
 
-  vector<float>& data() {
+  storage& data() {
     return data_;
   }
 
-  const vector<float>& data() const {
+  const storage& data() const {
     return data_;
   }
 
   template <class Inspector>
   friend typename Inspector::result_type inspect(Inspector& f,
                                                  square_matrix& x) {
-    return f(meta::type_name("square_matrix"), x.data_);
+    return f(meta::type_name("square_matrix"), x.dim_, x.data_);
   }
 
 private:
-  vector<float> data_;
+  size_t dim_;
+  storage data_;
 };
 
-template<size_t Size>
-bool operator==(const square_matrix<Size>& x, const square_matrix<Size>& y) {
-    return std::equal(x.begin(), x.end(), y.begin());
+bool operator==(const square_matrix& x, const square_matrix& y) {
+    return x.dim() == y.dim() && std::equal(x.begin(), x.end(), y.begin());
 }
 
-template<size_t Size>
-bool operator!=(const square_matrix<Size>& x, const square_matrix<Size>& y) {
+bool operator!=(const square_matrix& x, const square_matrix& y) {
     return !(x == y);
 }
 
-using matrix_type = square_matrix<matrix_size>;
+using matrix_type = square_matrix;
 
 float dot_product(const matrix_type& x,
                   const matrix_type& y,
                   size_t row, size_t column) {
   float result = 0.0f;
-  for (size_t k = 0; k < matrix_size; ++k)
+  for (size_t k = 0; k < x.dim(); ++k)
     result += x(row, k) * y(k, column);
   return result;
 }
 
 matrix_type simple_multiply(const matrix_type& x, const matrix_type& y) {
-  matrix_type result;
-  for (size_t row = 0; row < matrix_size; ++row)
-    for (size_t column = 0; column < matrix_size; ++column)
+  auto n = x.dim();
+  matrix_type result{n};
+  for (size_t row = 0; row < n; ++row)
+    for (size_t column = 0; column < n; ++column)
       result(row, column) = dot_product(x, y, row, column);
   return result;
 }
 
-matrix_type actor_multiply(const matrix_type& x, const matrix_type& y) {
-  actor_system_config cfg;
-  actor_system system{cfg};
-  matrix_type result;
-  for (size_t row = 0; row < matrix_size; ++row)
-    for (size_t column = 0; column < matrix_size; ++column)
-      system.spawn([&, row, column] {
-        result(row, column) = dot_product(x, y, row, column);
-      });
-  return result;
+// -- cache-blocked baseline --------------------------------------------------
+
+// a block_kc x block_nc panel of y (128 KiB) stays in L2 while the micro
+// kernel walks over block_mc rows of x
+static constexpr size_t block_mc = 64;
+static constexpr size_t block_kc = 256;
+static constexpr size_t block_nc = 128;
+
+// register tile of the micro kernel, rows x columns of the result
+static constexpr size_t tile_mr = 6;
+static constexpr size_t tile_nr = 16;
+
+// register tile of the transposed micro kernel, lanes run along k
+static constexpr size_t tile_t_mr = 2;
+static constexpr size_t tile_t_nr = 4;
+static constexpr size_t tile_t_lanes = 8;
+
+// adds x[i..i_end, k..k_end] * y[k..k_end, j..j_end] to z
+MATRIX_ALWAYS_INLINE void edge_tile(const float* x, const float* y, float* z,
+                                    size_t n, size_t i, size_t i_end,
+                                    size_t j, size_t j_end,
+                                    size_t k, size_t k_end) {
+  for (; i < i_end; ++i)
+    for (auto kk = k; kk < k_end; ++kk) {
+      auto a = x[i * n + kk];
+      for (auto jj = j; jj < j_end; ++jj)
+        z[i * n + jj] += a * y[kk * n + jj];
+    }
 }
 
-matrix_type actor_multiply2(const matrix_type& x, const matrix_type& y) {
-  actor_system_config cfg;
-  actor_system system{cfg};
-  matrix_type result;
-  for (size_t row = 0; row < matrix_size; ++row)
-    system.spawn([&, row] {
-      for (size_t column = 0; column < matrix_size; ++column) {
-        result(row, column) = dot_product(x, y, row, column);
+// same as edge_tile for a full tile_mr x tile_nr tile
+MATRIX_ALWAYS_INLINE void micro_tile(const float* x, const float* y, float* z,
+                                     size_t n, size_t i, size_t j,
+                                     size_t k, size_t k_end) {
+  float acc[tile_mr][tile_nr];
+  for (size_t r = 0; r < tile_mr; ++r)
+    for (size_t c = 0; c < tile_nr; ++c)
+      acc[r][c] = z[(i + r) * n + j + c];
+  for (; k < k_end; ++k) {
+    auto yk = y + k * n + j;
+    for (size_t r = 0; r < tile_mr; ++r) {
+      auto a = x[(i + r) * n + k];
+      for (size_t c = 0; c < tile_nr; ++c)
+        acc[r][c] += a * yk[c];
+    }
+  }
+  for (size_t r = 0; r < tile_mr; ++r)
+    for (size_t c = 0; c < tile_nr; ++c)
+      z[(i + r) * n + j + c] = acc[r][c];
+}
+
+#ifdef MATRIX_X86_KERNELS
+// keeps the tile in 12 of the 16 AVX registers; compilers spill when left
+// to vectorize micro_tile on their own
+__attribute__((target("avx2,fma")))
+void micro_tile_avx2(const float* x, const float* y, float* z, size_t n,
+                     size_t i, size_t j, size_t k, size_t k_end) {
+  static_assert(tile_mr == 6 && tile_nr == 16, "tile size mismatch");
+  __m256 acc[tile_mr][2];
+  for (size_t r = 0; r < tile_mr; ++r) {
+    acc[r][0] = _mm256_loadu_ps(z + (i + r) * n + j);
+    acc[r][1] = _mm256_loadu_ps(z + (i + r) * n + j + 8);
+  }
+  for (; k < k_end; ++k) {
+    auto y0 = _mm256_loadu_ps(y + k * n + j);
+    auto y1 = _mm256_loadu_ps(y + k * n + j + 8);
+    for (size_t r = 0; r < tile_mr; ++r) {
+      auto a = _mm256_broadcast_ss(x + (i + r) * n + k);
+      acc[r][0] = _mm256_fmadd_ps(a, y0, acc[r][0]);
+      acc[r][1] = _mm256_fmadd_ps(a, y1, acc[r][1]);
+    }
+  }
+  for (size_t r = 0; r < tile_mr; ++r) {
+    _mm256_storeu_ps(z + (i + r) * n + j, acc[r][0]);
+    _mm256_storeu_ps(z + (i + r) * n + j + 8, acc[r][1]);
+  }
+}
+#endif // MATRIX_X86_KERNELS
+
+using tile_fun = void (*)(const float*, const float*, float*, size_t, size_t,
+                          size_t, size_t, size_t);
+
+// z += x * y for a row-major m x n matrix x, a n x n matrix y and a
+// m x n matrix z; m < n selects a band of rows
+template <tile_fun MicroTile>
+MATRIX_ALWAYS_INLINE void blocked_body(const float* x, const float* y,
+                                       float* z, size_t m, size_t n) {
+  for (size_t kb = 0; kb < n; kb += block_kc) {
+    auto kb_end = std::min(kb + block_kc, n);
+    for (size_t jb = 0; jb < n; jb += block_nc) {
+      auto jb_end = std::min(jb + block_nc, n);
+      for (size_t ib = 0; ib < m; ib += block_mc) {
+        auto ib_end = std::min(ib + block_mc, m);
+        for (auto i = ib; i < ib_end; i += tile_mr) {
+          auto i_end = std::min(i + tile_mr, ib_end);
+          for (auto j = jb; j < jb_end; j += tile_nr) {
+            auto j_end = std::min(j + tile_nr, jb_end);
+            if (i_end - i == tile_mr && j_end - j == tile_nr)
+              MicroTile(x, y, z, n, i, j, kb, kb_end);
+            else
+              edge_tile(x, y, z, n, i, i_end, j, j_end, kb, kb_end);
+          }
+        }
       }
+    }
+  }
+}
+
+// z += x * transpose(t), i.e., every result is a dot product of two rows;
+// keeping tile_t_lanes partial sums per result avoids relying on the
+// compiler to reorder floating point additions
+MATRIX_ALWAYS_INLINE void blocked_t_body(const float* x, const float* t,
+                                         float* z, size_t m, size_t n) {
+  for (size_t jb = 0; jb < n; jb += block_nc) {
+    auto jb_end = std::min(jb + block_nc, n);
+    for (size_t kb = 0; kb < n; kb += block_kc) {
+      auto kb_end = std::min(kb + block_kc, n);
+      auto kv_end = kb + (kb_end - kb) / tile_t_lanes * tile_t_lanes;
+      for (size_t ib = 0; ib < m; ib += block_mc) {
+        auto ib_end = std::min(ib + block_mc, m);
+        for (auto i = ib; i < ib_end; i += tile_t_mr) {
+          auto mr = std::min(tile_t_mr, ib_end - i);
+          for (auto j = jb; j < jb_end; j += tile_t_nr) {
+            auto nr = std::min(tile_t_nr, jb_end - j);
+            if (mr != tile_t_mr || nr != tile_t_nr) {
+              for (auto r = i; r < i + mr; ++r)
+                for (auto c = j; c < j + nr; ++c) {
+                  auto sum = z[r * n + c];
+                  for (auto k = kb; k < kb_end; ++k)
+                    sum += x[r * n + k] * t[c * n + k];
+                  z[r * n + c] = sum;
+                }
+              continue;
+            }
+            float acc[tile_t_mr][tile_t_nr][tile_t_lanes] = {};
+            for (auto k = kb; k < kv_end; k += tile_t_lanes)
+              for (size_t r = 0; r < tile_t_mr; ++r)
+                for (size_t c = 0; c < tile_t_nr; ++c)
+                  for (size_t l = 0; l < tile_t_lanes; ++l)
+                    acc[r][c][l] += x[(i + r) * n + k + l]
+                                    * t[(j + c) * n + k + l];
+            for (size_t r = 0; r < tile_t_mr; ++r)
+              for (size_t c = 0; c < tile_t_nr; ++c) {
+                auto sum = z[(i + r) * n + j + c];
+                for (size_t l = 0; l < tile_t_lanes; ++l)
+                  sum += acc[r][c][l];
+                for (auto k = kv_end; k < kb_end; ++k)
+                  sum += x[(i + r) * n + k] * t[(j + c) * n + k];
+                z[(i + r) * n + j + c] = sum;
+              }
+          }
+        }
+      }
+    }
+  }
+}
+
+using gemm_fun = void (*)(const float*, const float*, float*, size_t, size_t);
+
+void blocked_generic(const float* x, const float* y, float* z, size_t m,
+                     size_t n) {
+  blocked_body<micro_tile>(x, y, z, m, n);
+}
+
+void blocked_t_generic(const float* x, const float* t, float* z, size_t m,
+                       size_t n) {
+  blocked_t_body(x, t, z, m, n);
+}
+
+#ifdef MATRIX_X86_KERNELS
+__attribute__((target("avx2,fma")))
+void blocked_avx2(const float* x, const float* y, float* z, size_t m,
+                  size_t n) {
+  blocked_body<micro_tile_avx2>(x, y, z, m, n);
+}
+
+__attribute__((target("avx2,fma")))
+void blocked_t_avx2(const float* x, const float* t, float* z, size_t m,
+                    size_t n) {
+  blocked_t_body(x, t, z, m, n);
+}
+#endif // MATRIX_X86_KERNELS
+
+bool has_avx2() {
+#ifdef MATRIX_X86_KERNELS
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+  return false;
+#endif
+}
+
+gemm_fun select_gemm(bool transposed) {
+#ifdef MATRIX_X86_KERNELS
+  if (has_avx2())
+    return transposed ? blocked_t_avx2 : blocked_avx2;
+#endif
+  return transposed ? blocked_t_generic : blocked_generic;
+}
+
+matrix_type transpose(const matrix_type& x) {
+  static constexpr size_t block = 32;
+  auto n = x.dim();
+  matrix_type result{n};
+  for (size_t rb = 0; rb < n; rb += block)
+    for (size_t cb = 0; cb < n; cb += block)
+      for (auto r = rb; r < std::min(rb + block, n); ++r)
+        for (auto c = cb; c < std::min(cb + block, n); ++c)
+          result(c, r) = x(r, c);
+  return result;
+}
+
+matrix_type blocked_multiply(const matrix_type& x, const matrix_type& y) {
+  static auto gemm = select_gemm(false);
+  auto n = x.dim();
+  matrix_type result{n};
+  gemm(x.data().data(), y.data().data(), result.data().data(), n, n);
+  return result;
+}
+
+// includes the transposition of y in the measured time
+matrix_type blocked_t_multiply(const matrix_type& x, const matrix_type& y) {
+  static auto gemm = select_gemm(true);
+  auto n = x.dim();
+  matrix_type result{n};
+  auto t = transpose(y);
+  gemm(x.data().data(), t.data().data(), result.data().data(), n, n);
+  return result;
+}
+
+// computes rows [first, last) of x * y into out
+void multiply_rows(const matrix_type& x, const matrix_type& y, size_t first,
+                   size_t last, float* out) {
+  for (auto row = first; row < last; ++row)
+    for (size_t column = 0; column < x.dim(); ++column)
+      *out++ = dot_product(x, y, row, column);
+}
+
+// the actor variants return once all results arrived at the caller, i.e.,
+// the measured time does not include starting or stopping the actor system
+
+matrix_type actor_multiply(actor_system& system, const matrix_type& x,
+                           const matrix_type& y) {
+  auto n = x.dim();
+  matrix_type result{n};
+  scoped_actor self{system};
+  for (size_t row = 0; row < n; ++row)
+    for (size_t column = 0; column < n; ++column)
+      system.spawn([&x, &y, row, column](event_based_actor* ptr, actor dst) {
+        ptr->send(dst, row, column, dot_product(x, y, row, column));
+      }, actor{self});
+  for (size_t i = 0; i < result.num_elements(); ++i)
+    self->receive([&](size_t row, size_t column, float value) {
+      result(row, column) = value;
+    });
+  return result;
+}
+
+// spawns one actor per `grain` rows
+matrix_type actor_multiply2(actor_system& system, const matrix_type& x,
+                            const matrix_type& y, size_t grain) {
+  auto n = x.dim();
+  matrix_type result{n};
+  scoped_actor self{system};
+  size_t num_tasks = 0;
+  for (size_t row = 0; row < n; row += grain, ++num_tasks)
+    system.spawn([&x, &y, row, grain](event_based_actor* ptr, actor dst) {
+      auto last = std::min(row + grain, x.dim());
+      vector<float> values((last - row) * x.dim());
+      multiply_rows(x, y, row, last, values.data());
+      ptr->send(dst, row, std::move(values));
+    }, actor{self});
+  for (size_t i = 0; i < num_tasks; ++i)
+    self->receive([&](size_t row, const vector<float>& values) {
+      std::copy(values.begin(), values.end(), &result(row, 0));
     });
   return result;
 }
@@ -161,16 +481,17 @@ matrix_type async_multiply(const matrix_type&, const matrix_type&) {
   throw std::logic_error("Not available on this platform");
 }
 
-matrix_type async_multiply2(const matrix_type&, const matrix_type&) {
+matrix_type async_multiply2(const matrix_type&, const matrix_type&, size_t) {
   throw std::logic_error("Not available on this platform");
 }
 #else // defined(CAF_GCC) && defined(CAF_MACOS)
 matrix_type async_multiply(const matrix_type& x, const matrix_type& y) {
-  matrix_type result;
+  auto n = x.dim();
+  matrix_type result{n};
   vector<future<void>> futures;
-  futures.reserve(matrix_size * matrix_size);
-  for (size_t row = 0; row < matrix_size; ++row) {
-    for (size_t column = 0; column < matrix_size; ++column) {
+  futures.reserve(result.num_elements());
+  for (size_t row = 0; row < n; ++row) {
+    for (size_t column = 0; column < n; ++column) {
       futures.push_back(std::async(std::launch::async, [&, row, column] {
         result(row, column) = dot_product(x, y, row, column);
       }));
@@ -181,15 +502,16 @@ matrix_type async_multiply(const matrix_type& x, const matrix_type& y) {
   return result;
 }
 
-matrix_type async_multiply2(const matrix_type& x, const matrix_type& y) {
-  matrix_type result;
+// launches one thread per `grain` rows
+matrix_type async_multiply2(const matrix_type& x, const matrix_type& y,
+                            size_t grain) {
+  auto n = x.dim();
+  matrix_type result{n};
   vector<future<void>> futures;
-  futures.reserve(matrix_size);
-  for (size_t row = 0; row < matrix_size; ++row) {
-    futures.push_back(std::async(std::launch::async, [&,row] {
-      for (size_t column = 0; column < matrix_size; ++column) {
-        result(row, column) = dot_product(x, y, row, column);
-      }
+  futures.reserve(n / grain + 1);
+  for (size_t row = 0; row < n; row += grain) {
+    futures.push_back(std::async(std::launch::async, [&, row] {
+      multiply_rows(x, y, row, std::min(row + grain, n), &result(row, 0));
     }));
   }
   for (auto& f : futures)
@@ -198,6 +520,264 @@ matrix_type async_multiply2(const matrix_type& x, const matrix_type& y) {
 }
 #endif // defined(CAF_GCC) && defined(CAF_MACOS)
 
+// a fixed set of threads with one deque per thread: owners take work from
+// the back of their deque and steal from the front of others when idle,
+// like the work-stealing policy of CAF (including mutex-guarded deques)
+class work_stealing_pool {
+public:
+  using job = std::function<void ()>;
+
+  explicit work_stealing_pool(size_t num_workers)
+      : remaining_(0),
+        epoch_(0),
+        shutdown_(false) {
+    for (size_t i = 0; i < num_workers; ++i)
+      queues_.emplace_back(new job_queue);
+    for (size_t i = 0; i < num_workers; ++i)
+      threads_.emplace_back([=] { worker_loop(i); });
+  }
+
+  ~work_stealing_pool() {
+    {
+      std::lock_guard<std::mutex> guard{mtx_};
+      shutdown_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& t : threads_)
+      t.join();
+  }
+
+  size_t num_workers() const {
+    return threads_.size();
+  }
+
+  // distributes `jobs` round-robin and blocks until all of them ran
+  void run(vector<job> jobs) {
+    if (jobs.empty())
+      return;
+    remaining_ = jobs.size();
+    for (size_t i = 0; i < jobs.size(); ++i) {
+      auto& q = *queues_[i % queues_.size()];
+      std::lock_guard<std::mutex> guard{q.mtx};
+      q.jobs.push_back(std::move(jobs[i]));
+    }
+    std::unique_lock<std::mutex> guard{mtx_};
+    ++epoch_;
+    work_cv_.notify_all();
+    done_cv_.wait(guard, [&] { return remaining_ == 0; });
+  }
+
+private:
+  struct job_queue {
+    std::mutex mtx;
+    std::deque<job> jobs;
+  };
+
+  bool take(size_t id, job& out) {
+    auto& own = *queues_[id];
+    {
+      std::lock_guard<std::mutex> guard{own.mtx};
+      if (!own.jobs.empty()) {
+        out = std::move(own.jobs.back());
+        own.jobs.pop_back();
+        return true;
+      }
+    }
+    for (size_t i = 1; i < queues_.size(); ++i) {
+      auto& victim = *queues_[(id + i) % queues_.size()];
+      std::lock_guard<std::mutex> guard{victim.mtx};
+      if (!victim.jobs.empty()) {
+        out = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void worker_loop(size_t id) {
+    uint64_t seen_epoch = 0;
+    job j;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> guard{mtx_};
+        work_cv_.wait(guard, [&] { return shutdown_ || epoch_ != seen_epoch; });
+        if (shutdown_)
+          return;
+        seen_epoch = epoch_;
+      }
+      // keep looking for work until every job of this epoch ran
+      while (remaining_ > 0) {
+        if (!take(id, j)) {
+          std::this_thread::yield();
+          continue;
+        }
+        j();
+        j = nullptr;
+        if (--remaining_ == 0) {
+          std::lock_guard<std::mutex> guard{mtx_};
+          done_cv_.notify_all();
+        }
+      }
+    }
+  }
+
+  vector<std::unique_ptr<job_queue>> queues_;
+  vector<std::thread> threads_;
+  std::atomic<size_t> remaining_;
+  std::mutex mtx_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  uint64_t epoch_;
+  bool shutdown_;
+};
+
+// runs the same tasks as actor_multiply2 on a work_stealing_pool
+matrix_type pool_multiply(work_stealing_pool& pool, const matrix_type& x,
+                          const matrix_type& y, size_t grain) {
+  auto n = x.dim();
+  matrix_type result{n};
+  vector<work_stealing_pool::job> jobs;
+  jobs.reserve(n / grain + 1);
+  for (size_t row = 0; row < n; row += grain)
+    jobs.emplace_back([&, row] {
+      multiply_rows(x, y, row, std::min(row + grain, n), &result(row, 0));
+    });
+  pool.run(std::move(jobs));
+  return result;
+}
+
+// -- tiled actors -------------------------------------------------------------
+
+// an immutable square block of an operand, shared between all messages that
+// need it instead of copying its elements into each message
+class tile : public ref_counted {
+public:
+  explicit tile(size_t dim) : values(dim * dim) {
+    // nop
+  }
+
+  square_matrix::storage values;
+};
+
+using tile_ptr = intrusive_ptr<const tile>;
+
+using tile_vector = vector<tile_ptr>;
+
+CAF_ALLOW_UNSAFE_MESSAGE_TYPE(tile_vector)
+
+using multiply_atom = atom_constant<atom("multiply")>;
+using done_atom = atom_constant<atom("done")>;
+
+// splits x into tiles[row][column], zero-padding the tiles at the edges
+vector<tile_vector> make_tiles(const matrix_type& x, size_t dim) {
+  auto n = x.dim();
+  auto num_tiles = (n + dim - 1) / dim;
+  vector<tile_vector> result(num_tiles);
+  for (size_t tr = 0; tr < num_tiles; ++tr) {
+    for (size_t tc = 0; tc < num_tiles; ++tc) {
+      auto t = make_counted<tile>(dim);
+      auto rows = std::min(dim, n - tr * dim);
+      auto columns = std::min(dim, n - tc * dim);
+      for (size_t r = 0; r < rows; ++r)
+        std::copy_n(&x(tr * dim + r, tc * dim), columns, &t->values[r * dim]);
+      result[tr].emplace_back(std::move(t));
+    }
+  }
+  return result;
+}
+
+// the part of the result matrix owned by a single tile actor
+struct result_slice {
+  float* data;
+  size_t stride;
+  size_t rows;
+  size_t columns;
+};
+
+// computes sum(xs[k] * ys[k]) for dim x dim tiles into `out`
+void multiply_tiles(const vector<const float*>& xs,
+                    const vector<const float*>& ys, size_t dim,
+                    const result_slice& out) {
+  static auto gemm = select_gemm(false);
+  square_matrix::storage acc(dim * dim);
+  for (size_t k = 0; k < xs.size(); ++k)
+    gemm(xs[k], ys[k], acc.data(), dim, dim);
+  for (size_t r = 0; r < out.rows; ++r)
+    std::copy_n(&acc[r * dim], out.columns, out.data + r * out.stride);
+}
+
+behavior tile_actor(event_based_actor* self, size_t dim, result_slice out) {
+  return {
+    // zero-copy: operands arrive as references to shared tiles
+    [=](multiply_atom, const tile_vector& xs, const tile_vector& ys) {
+      vector<const float*> xps;
+      vector<const float*> yps;
+      for (size_t k = 0; k < xs.size(); ++k) {
+        xps.push_back(xs[k]->values.data());
+        yps.push_back(ys[k]->values.data());
+      }
+      multiply_tiles(xps, yps, dim, out);
+      self->quit();
+      return done_atom::value;
+    },
+    // operands arrive as copies, concatenated tile by tile
+    [=](multiply_atom, const vector<float>& xs, const vector<float>& ys) {
+      vector<const float*> xps;
+      vector<const float*> yps;
+      for (size_t k = 0; k < xs.size(); k += dim * dim) {
+        xps.push_back(xs.data() + k);
+        yps.push_back(ys.data() + k);
+      }
+      multiply_tiles(xps, yps, dim, out);
+      self->quit();
+      return done_atom::value;
+    }
+  };
+}
+
+// spawns one actor per result tile, each writing into its preallocated
+// slice of the result; with `copy_operands` set, each message carries copies
+// of the tiles instead of references to them
+matrix_type tiled_multiply(actor_system& system, const matrix_type& x,
+                           const matrix_type& y, size_t dim,
+                           bool copy_operands) {
+  auto n = x.dim();
+  matrix_type result{n};
+  auto xt = make_tiles(x, dim);
+  auto yt = make_tiles(y, dim);
+  auto num_tiles = xt.size();
+  auto copy_tiles = [&](const tile_vector& xs) {
+    vector<float> values;
+    values.reserve(xs.size() * dim * dim);
+    for (auto& t : xs)
+      values.insert(values.end(), t->values.begin(), t->values.end());
+    return values;
+  };
+  scoped_actor self{system};
+  for (size_t tr = 0; tr < num_tiles; ++tr) {
+    for (size_t tc = 0; tc < num_tiles; ++tc) {
+      result_slice out{&result(tr * dim, tc * dim), n,
+                       std::min(dim, n - tr * dim),
+                       std::min(dim, n - tc * dim)};
+      auto worker = system.spawn(tile_actor, dim, out);
+      tile_vector ys;
+      for (size_t k = 0; k < num_tiles; ++k)
+        ys.push_back(yt[k][tc]);
+      if (copy_operands)
+        self->send(worker, multiply_atom::value, copy_tiles(xt[tr]),
+                   copy_tiles(ys));
+      else
+        self->send(worker, multiply_atom::value, xt[tr], std::move(ys));
+    }
+  }
+  for (size_t i = 0; i < num_tiles * num_tiles; ++i)
+    self->receive([](done_atom) {
+      // nop
+    });
+  return result;
+}
+
 #ifdef ENABLE_OPENCL
 matrix_type opencl_multiply(const matrix_type& x, const matrix_type& y) {
     static constexpr const char* source = R"__(
@@ -214,16 +794,17 @@ matrix_type opencl_multiply(const matrix_type& x, const matrix_type& y) {
             result[row + column * size] = dot_product;
         }
     )__";
-    matrix_type result;
+    matrix_type result{x.dim()};
     auto worker = spawn_cl<vector<float>(const vector<float>&,
                                          const vector<float>&)>(source,
                                                                 "multiply",
-                                                                matrix_size,
-                                                                matrix_size);
-   send(worker, x.data(), y.data());
+                                                                x.dim(),
+                                                                x.dim());
+   send(worker, vector<float>(x.begin(), x.end()),
+        vector<float>(y.begin(), y.end()));
     receive(
         on_arg_match >> [&](std::vector<float>& res_vec) {
-            result = std::move(res_vec);
+            std::copy(res_vec.begin(), res_vec.end(), result.data().begin());
         }
     );
     return result;
@@ -235,28 +816,188 @@ matrix_type opencl_multiply(const matrix_type&, const matrix_type&) {
 }
 #endif
 
+// returns the index of the first element in `result` that differs from x * y
+// or `result.num_elements()`; the reference sums in the same order as
+// simple_multiply but is computed row-wise for speed, covering all rows up to
+// check_all_rows and evenly spaced rows for larger matrices
+static constexpr size_t check_all_rows = 1024;
+static constexpr size_t check_sampled_rows = 64;
+
+class result_checker {
+public:
+  result_checker(const matrix_type& x, const matrix_type& y) : n_(x.dim()) {
+    auto step = std::max(size_t{1}, n_ / check_sampled_rows);
+    if (n_ <= check_all_rows)
+      step = 1;
+    for (size_t row = 0; row < n_; row += step)
+      rows_.push_back(row);
+    if (rows_.back() != n_ - 1)
+      rows_.push_back(n_ - 1);
+    expected_.resize(rows_.size() * n_);
+    auto out = expected_.begin();
+    for (auto row : rows_) {
+      for (size_t k = 0; k < n_; ++k) {
+        auto a = x(row, k);
+        for (size_t column = 0; column < n_; ++column)
+          out[column] += a * y(k, column);
+      }
+      out += n_;
+    }
+  }
+
+  size_t first_mismatch(const matrix_type& result) const {
+    // the variants sum in different orders, hence compare with a tolerance
+    auto expected = expected_.begin();
+    for (auto row : rows_) {
+      for (size_t column = 0; column < n_; ++column, ++expected)
+        if (std::fabs(result(row, column) - *expected)
+            > 1e-4f * std::fabs(*expected))
+          return row * n_ + column;
+    }
+    return result.num_elements();
+  }
+
+private:
+  size_t n_;
+  vector<size_t> rows_;
+  vector<float> expected_;
+};
+
+vector<size_t> parse_sizes(const string& str) {
+  vector<size_t> result;
+  std::istringstream in{str};
+  string item;
+  while (getline(in, item, ','))
+    result.push_back(std::stoul(item));
+  return result;
+}
+
+void usage(const char* program) {
+  cerr << "usage: " << program
+       << " [--size=N[,N...]|--sweep] [--grain=ROWS] [--tile=DIM]"
+          " --(simple|blocked|blocked-t|actor|actor2|async|async2|pool|"
+          "tiles|tiles-copy|opencl)..."
+       << endl;
+}
+
 int main(int argc, char** argv) {
-  if (argc != 2) {
-    cerr << "usage: " << argv[0] << " --(simple|actor|async|opencl)" << endl;
+  auto placement = thread_placement::from_args(argc, argv);
+  vector<size_t> sizes{1000};
+  size_t grain = 1;
+  size_t tile_dim = 128;
+  vector<string> names;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      string arg = argv[i];
+      if (arg.compare(0, 7, "--size=") == 0) {
+        sizes = parse_sizes(arg.substr(7));
+      } else if (arg == "--sweep") {
+        sizes.clear();
+        for (size_t n = 64; n <= 8192; n *= 2)
+          sizes.push_back(n);
+      } else if (arg.compare(0, 8, "--grain=") == 0) {
+        grain = std::stoul(arg.substr(8));
+      } else if (arg.compare(0, 7, "--tile=") == 0) {
+        tile_dim = std::stoul(arg.substr(7));
+      } else {
+        names.push_back(std::move(arg));
+      }
+    }
+  } catch (std::exception&) {
+    usage(argv[0]);
     return -1;
   }
-  using fun = matrix_type (*)(const matrix_type&, const matrix_type&);
-  std::map<string, fun> funs{
-    {"--simple", simple_multiply},
-    {"--actor", actor_multiply},
-    {"--actor2", actor_multiply2},
-    {"--async", async_multiply},
-    {"--async2", async_multiply2},
-    {"--opencl", opencl_multiply}
-  };
-  auto x = funs.find(argv[1]);
-  if (x == funs.end()) {
-    cerr << "invalid command line option" << endl;
+  if (names.empty() || grain == 0 || tile_dim == 0
+      || std::count(sizes.begin(), sizes.end(), size_t{0}) > 0) {
+    usage(argv[0]);
     return -1;
   }
-  matrix_type a;
-  a.iota_fill();
-  matrix_type b;
-  b.iota_fill();
-  (x->second)(a, b);
+  actor_system_config cfg;
+  cfg.scheduler_max_threads = topology::local().usable_cpus();
+  placement.prepare();
+  actor_system system{cfg};
+  // pins the scheduler workers only, not the threads of the pool
+  placement.apply(cfg.scheduler_max_threads);
+  // only exists if --pool runs, its threads would compete with all other
+  // strategies otherwise
+  std::unique_ptr<work_stealing_pool> pool;
+  using fun = std::function<matrix_type (const matrix_type&,
+                                         const matrix_type&)>;
+  using namespace std::placeholders;
+  // strategies with one task per element or a naive loop nest are skipped
+  // for sizes above max_size, because they would run for hours
+  struct strategy {
+    fun f;
+    size_t max_size;
+  };
+  auto unlimited = std::numeric_limits<size_t>::max();
+  std::map<string, strategy> strategies{
+    {"--simple", {simple_multiply, 2048}},
+    {"--blocked", {blocked_multiply, unlimited}},
+    {"--blocked-t", {blocked_t_multiply, unlimited}},
+    {"--actor", {std::bind(actor_multiply, std::ref(system), _1, _2), 1024}},
+    {"--actor2", {std::bind(actor_multiply2, std::ref(system), _1, _2, grain),
+                  unlimited}},
+    {"--async", {async_multiply, 256}},
+    {"--async2", {std::bind(async_multiply2, _1, _2, grain), unlimited}},
+    {"--pool", {[&](const matrix_type& x, const matrix_type& y) {
+                  return pool_multiply(*pool, x, y, grain);
+                },
+                unlimited}},
+    {"--tiles", {std::bind(tiled_multiply, std::ref(system), _1, _2,
+                           tile_dim, false),
+                 unlimited}},
+    {"--tiles-copy", {std::bind(tiled_multiply, std::ref(system), _1, _2,
+                                tile_dim, true),
+                      unlimited}},
+    {"--opencl", {opencl_multiply, unlimited}}
+  };
+  for (auto& name : names) {
+    if (strategies.count(name) == 0) {
+      cerr << "invalid command line option: " << name << endl;
+      return -1;
+    }
+  }
+  // every strategy is compared to the single-threaded baseline
+  if (std::find(names.begin(), names.end(), "--blocked") == names.end())
+    names.insert(names.begin(), "--blocked");
+  // start the pool outside of the timed region
+  if (std::find(names.begin(), names.end(), "--pool") != names.end())
+    pool.reset(new work_stealing_pool{topology::local().usable_cpus()});
+  cout << "GFLOP/s, grain = " << grain << " rows, tile = " << tile_dim
+       << ", baseline kernel: "
+       << (has_avx2() ? "avx2" : "generic") << endl
+       << setw(6) << "size";
+  for (auto& name : names)
+    cout << setw(12) << name;
+  cout << endl << fixed << setprecision(2);
+  int exit_code = 0;
+  for (auto n : sizes) {
+    matrix_type a{n};
+    a.iota_fill();
+    matrix_type b{n};
+    b.iota_fill();
+    result_checker checker{a, b};
+    cout << setw(6) << n << flush;
+    for (auto& name : names) {
+      auto& s = strategies[name];
+      if (n > s.max_size) {
+        cout << setw(12) << "-" << flush;
+        continue;
+      }
+      auto t0 = chrono::steady_clock::now();
+      auto result = s.f(a, b);
+      auto t1 = chrono::steady_clock::now();
+      auto seconds = chrono::duration<double>(t1 - t0).count();
+      cout << setw(12) << 2.0 * n * n * n / seconds / 1e9 << flush;
+      auto pos = checker.first_mismatch(result);
+      if (pos != result.num_elements()) {
+        cerr << endl << name << ": wrong result at (" << pos / n << ", "
+             << pos % n << ") for size " << n << endl;
+        exit_code = 1;
+      }
+    }
+    cout << endl;
+  }
+  return exit_code;
 }
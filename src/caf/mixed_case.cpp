@@ -17,27 +17,58 @@
  * http://www.boost.org/LICENSE_1_0.txt.                                      *
  ******************************************************************************/
 
+#include <map>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cerrno>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <numeric>
 #include <iostream>
+#include <algorithm>
 #include <functional>
 
 #include "caf/all.hpp"
 
+#include "topology.hpp"
+#include "placement.hpp"
+#include "sample_set.hpp"
+
 using std::cout;
+using std::cerr;
 using std::endl;
 
 using namespace caf;
 
+using hrc = std::chrono::high_resolution_clock;
+
+CAF_ALLOW_UNSAFE_MESSAGE_TYPE(hrc::time_point)
+
 namespace {
 
 using factors = std::vector<uint64_t>;
 
+// nanoseconds per sample, shares its type (and type ID) with `factors`
+using durations = std::vector<uint64_t>;
+
+uint64_t ns_since(hrc::time_point t0) {
+  using namespace std::chrono;
+  return static_cast<uint64_t>(
+    duration_cast<nanoseconds>(hrc::now() - t0).count());
+}
+
 constexpr uint64_t s_factor1 = 86028157;
 constexpr uint64_t s_factor2 = 329545133;
 constexpr uint64_t s_task_n = s_factor1 * s_factor2;
 
+// numbers handed to the factorizer, ring iteration `i` uses `s_tasks[i % n]`
+std::vector<uint64_t> s_tasks{s_task_n};
+
 using calc_atom = atom_constant<atom("calc")>;
 using done_atom = atom_constant<atom("done")>;
 using token_atom = atom_constant<atom("token")>;
@@ -62,18 +93,56 @@ factors factorize(uint64_t n) {
 }
 
 inline void check_factors(const factors& vec) {
-    assert(vec.size() == 2);
-    assert(vec[0] == s_factor1);
-    assert(vec[1] == s_factor2);
+    assert(!vec.empty());
+    assert(std::count(s_tasks.begin(), s_tasks.end(),
+                      std::accumulate(vec.begin(), vec.end(), uint64_t{1},
+                                      std::multiplies<uint64_t>{})) > 0);
 #   ifdef NDEBUG
     static_cast<void>(vec);
 #   endif
 }
 
+bool is_prime(uint64_t n) {
+  if (n < 4)
+    return n > 1;
+  if (n % 2 == 0)
+    return false;
+  for (uint64_t d = 3; d * d <= n; d += 2)
+    if (n % d == 0)
+      return false;
+  return true;
+}
+
+// `factorize(3 * q)` runs about q/2 loop iterations for a prime q, hence we
+// measure the loop speed on this machine and pick q to match the target time
+uint64_t calibrate_task(int work_us) {
+  if (work_us <= 0)
+    return 4; // a single division, i.e., pure messaging
+  using namespace std::chrono;
+  constexpr uint64_t probe_prime = 1000003;
+  uint64_t iterations = 0;
+  auto t0 = steady_clock::now();
+  auto elapsed = steady_clock::duration::zero();
+  do {
+    auto res = factorize(3 * probe_prime);
+    assert(res.back() == probe_prime);
+    static_cast<void>(res);
+    iterations += probe_prime / 2;
+    elapsed = steady_clock::now() - t0;
+  } while (elapsed < milliseconds(20));
+  auto ns = duration_cast<nanoseconds>(elapsed).count();
+  auto per_us = static_cast<double>(iterations) * 1000. / ns;
+  auto q = std::max(uint64_t{5},
+                    static_cast<uint64_t>(2 * per_us * work_us));
+  while (!is_prime(q))
+    ++q;
+  return 3 * q;
+}
+
 behavior worker(event_based_actor* self) {
   return {
-    [](calc_atom, uint64_t what) {
-      return factorize(what);
+    [](calc_atom, uint64_t what, int ring, hrc::time_point t0) {
+      return std::make_tuple(factorize(what), ring, t0);
     },
     [=](done_atom) {
       self->quit();
@@ -93,8 +162,10 @@ behavior chain_link(event_based_actor* self, const actor& next) {
 
 class chain_master : public event_based_actor {
  public:
-    chain_master(actor_config& cfg, actor coll, int rs, uint64_t itv, int n)
+    chain_master(actor_config& cfg, actor coll, int id, int rs, uint64_t itv,
+                 int n)
       : event_based_actor(cfg),
+        id_(id),
         iteration_(0),
         ring_size_(rs),
         m_initial_token_value(itv),
@@ -110,11 +181,12 @@ class chain_master : public event_based_actor {
       return {
         [=](token_atom tk, uint64_t value) {
           if (value == 0) {
+            iteration_times_.push_back(ns_since(iteration_start_));
             if (++iteration_ < num_iterations_) {
               new_ring();
             } else {
               send(factorizer_, done_atom::value);
-              send(mc_, done_atom::value);
+              send(mc_, done_atom::value, id_, iteration_times_);
               quit();
             }
           } else {
@@ -127,12 +199,16 @@ class chain_master : public event_based_actor {
 
  private:
   void new_ring() {
-    send_as(mc_, factorizer_, calc_atom::value, s_task_n);
+    iteration_start_ = hrc::now();
+    send_as(mc_, factorizer_, calc_atom::value,
+            s_tasks[static_cast<size_t>(iteration_) % s_tasks.size()], id_,
+            iteration_start_);
     next_ = this;
     for (int i = 1; i < ring_size_; ++i)
       next_ = spawn<lazy_init>(chain_link, next_);
     send(next_, token_atom::value, m_initial_token_value);
   }
+  int id_;
   int iteration_;
   int ring_size_;
   uint64_t m_initial_token_value;
@@ -140,53 +216,191 @@ class chain_master : public event_based_actor {
   actor mc_;
   actor next_;
   actor factorizer_;
+  hrc::time_point iteration_start_;
+  durations iteration_times_;
+};
+
+// samples of one ring, i.e., one `chain_master`
+struct ring_samples {
+  sample_set iterations; // time for one `new_ring` round trip
+  sample_set calcs;      // time from sending `calc_atom` to receiving `factors`
 };
 
+// prints "2^k:n" for each non-empty bucket [2^k, 2^(k+1)) in microseconds
+void print_histogram(std::ostream& out, const durations& xs) {
+  std::map<int, size_t> buckets;
+  for (auto x : xs) {
+    int k = 0;
+    for (auto us = x / 1000; us > 1; us >>= 1)
+      ++k;
+    ++buckets[k];
+  }
+  for (auto& kvp : buckets)
+    out << " 2^" << kvp.first << ":" << kvp.second;
+}
+
+void print_report(std::ostream& out, std::map<int, ring_samples>& rings) {
+  out << "ring iterations iter_mean_us iter_p50_us iter_p99_us iter_max_us "
+         "calc_mean_us calc_p50_us calc_p99_us calc_max_us" << endl;
+  sample_set ring_means;
+  for (auto& kvp : rings) {
+    auto& xs = kvp.second.iterations;
+    auto& ys = kvp.second.calcs;
+    ring_means.add(static_cast<uint64_t>(xs.mean()));
+    out << kvp.first << " " << xs.count()
+        << " " << xs.mean() / 1000 << " " << xs.percentile(.5) / 1000
+        << " " << xs.percentile(.99) / 1000
+        << " " << xs.percentile(1.) / 1000
+        << " " << ys.mean() / 1000 << " " << ys.percentile(.5) / 1000
+        << " " << ys.percentile(.99) / 1000
+        << " " << ys.percentile(1.) / 1000 << endl;
+  }
+  for (auto& kvp : rings) {
+    out << "histogram ring " << kvp.first << " iterations [us]:";
+    print_histogram(out, kvp.second.iterations.samples());
+    out << endl << "histogram ring " << kvp.first << " calcs [us]:";
+    print_histogram(out, kvp.second.calcs.samples());
+    out << endl;
+  }
+  // a fair scheduler gives all rings about the same mean iteration time
+  auto m = ring_means.mean();
+  auto& means = ring_means.samples();
+  auto var = std::accumulate(means.begin(), means.end(), 0.,
+                             [=](double res, uint64_t x) {
+                               auto d = static_cast<double>(x) - m;
+                               return res + d * d;
+                             });
+  if (ring_means.count() > 0 && m > 0)
+    out << "fairness: min/max ring mean = "
+        << static_cast<double>(ring_means.percentile(0.))
+           / static_cast<double>(ring_means.percentile(1.))
+        << ", coefficient of variation = "
+        << std::sqrt(var / static_cast<double>(ring_means.count())) / m
+        << endl;
+}
+
 class supervisor : public event_based_actor {
  public:
-  supervisor(actor_config& cfg, int num_msgs)
+  supervisor(actor_config& cfg, int num_msgs, std::string out_file)
       : event_based_actor(cfg),
-        left_(num_msgs) {
+        left_(num_msgs),
+        out_file_(std::move(out_file)) {
     // nop
   }
 
   behavior make_behavior() override {
     return {
-      [=](const factors& vec) {
+      [=](const factors& vec, int ring, hrc::time_point t0) {
+        rings_[ring].calcs.add(ns_since(t0));
         check_factors(vec);
         if (--left_ == 0)
-          quit();
+          done();
       },
-      [=](done_atom) {
+      [=](done_atom, int ring, const durations& xs) {
+        for (auto x : xs)
+          rings_[ring].iterations.add(x);
         if (--left_ == 0)
-          quit();
+          done();
       }
     };
   }
 
  private:
+  void done() {
+    if (out_file_ == "-") {
+      print_report(cout, rings_);
+    } else if (!out_file_.empty()) {
+      std::ofstream out{out_file_};
+      print_report(out, rings_);
+    }
+    quit();
+  }
+
   int left_;
+  std::string out_file_;
+  std::map<int, ring_samples> rings_;
+};
+
+class my_config : public actor_system_config {
+public:
+  int work_us = -1;
+  std::string semiprimes;
+  std::string latency_out;
+
+  my_config() {
+    opt_group{custom_options_, "global"}
+      .add(work_us, "work-us",
+           "size each factorization to take about N microseconds")
+      .add(semiprimes, "semiprimes",
+           "comma-separated numbers to factorize, cycled per ring iteration")
+      .add(latency_out, "latency-out",
+           "write per-ring latency histograms to file (\"-\" for stdout)");
+  }
 };
 
+int usage() {
+  cout << "usage: mixed_case "
+          "NUM_RINGS RING_SIZE INITIAL_TOKEN_VALUE REPETITIONS"
+          " [--work-us=N|--semiprimes=N1,N2,...]"
+          " [--latency-out=FILE]"
+          " [--pin=POLICY] [--numa-mem=POLICY]"
+       << endl << endl;
+  return 1;
+}
+
 } // namespace <anonymous>
 
 int main(int argc, char** argv) {
-  if (argc != 5)
-    return cout << "usage: mixed_case "
-                   "NUM_RINGS RING_SIZE INITIAL_TOKEN_VALUE REPETITIONS"
-                << endl << endl, 1;
-  auto num_rings = atoi(argv[1]);
-  auto ring_size = atoi(argv[2]);
-  auto initial_token_value = static_cast<uint64_t>(atoi(argv[3]));
-  auto repetitions = atoi(argv[4]);
-  actor_system_config cfg;
+  auto placement = thread_placement::from_args(argc, argv);
+  my_config cfg;
+  // size the scheduler to the CPUs available in containers and under
+  // taskset, --scheduler.max-threads still overrides this
+  cfg.scheduler_max_threads = topology::local().usable_cpus();
   cfg.parse(argc, argv, "caf-application.ini");
+  if (cfg.args_remainder.size() != 4)
+    return usage();
+  auto arg = [&](size_t i) {
+    return cfg.args_remainder.get_as<std::string>(i).c_str();
+  };
+  auto num_rings = atoi(arg(0));
+  auto ring_size = atoi(arg(1));
+  auto initial_token_value = static_cast<uint64_t>(atoi(arg(2)));
+  auto repetitions = atoi(arg(3));
+  if (!cfg.semiprimes.empty()) {
+    s_tasks.clear();
+    std::string::size_type pos = 0;
+    while (pos != std::string::npos) {
+      auto next = cfg.semiprimes.find(',', pos);
+      auto item = cfg.semiprimes.substr(pos, next - pos);
+      // strtoull skips blanks and accepts signs, "-5" would wrap around
+      char* end = nullptr;
+      errno = 0;
+      auto n = strtoull(item.c_str(), &end, 10);
+      if (item.empty() || !isdigit(item[0]) || *end != '\0'
+          || errno == ERANGE) {
+        cerr << "not a number: " << item << endl;
+        return usage();
+      }
+      if (n == 0)
+        return cerr << "cannot factorize 0" << endl, 1;
+      s_tasks.push_back(n);
+      pos = next == std::string::npos ? next : next + 1;
+    }
+  } else if (cfg.work_us >= 0) {
+    s_tasks.assign(1, calibrate_task(cfg.work_us));
+    cerr << "factorize " << s_tasks.front() << " (~" << cfg.work_us
+         << "us per task)" << endl;
+  }
   cfg.add_message_type<factors>("factors");
+  placement.prepare();
   actor_system system{cfg};
+  placement.apply(cfg.scheduler_max_threads);
   auto sv = system.spawn<supervisor, lazy_init>(num_rings
-                                                + (num_rings * repetitions));
+                                                + (num_rings * repetitions),
+                                                cfg.latency_out);
   for (int i = 0; i < num_rings; ++i)
-    system.spawn<chain_master>(sv, ring_size, initial_token_value, repetitions);
+    system.spawn<chain_master>(sv, i, ring_size, initial_token_value,
+                               repetitions);
 }
 
 
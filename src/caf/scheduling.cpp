@@ -19,17 +19,32 @@
 
 #include <vector>
 #include <chrono>
+#include <random>
+#include <thread>
+#include <limits>
+#include <string>
+#include <cstdlib>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
 
 #include "caf/all.hpp"
 
 #include "caf/scheduler/profiled_coordinator.hpp"
 
+#include "topology.hpp"
+#include "sample_set.hpp"
+#include "placement.hpp"
+
 using namespace std;
 using namespace caf;
 using namespace std::chrono;
 
 using task_atom = atom_constant<atom("task")>;
 using result_atom = atom_constant<atom("result")>;
+using work_atom = atom_constant<atom("work")>;
+using stage_atom = atom_constant<atom("stage")>;
 
 template <class T>
 auto ms(T x, T y) -> decltype(duration_cast<milliseconds>(y - x).count()) {
@@ -38,19 +53,70 @@ auto ms(T x, T y) -> decltype(duration_cast<milliseconds>(y - x).count()) {
 
 using hrc = high_resolution_clock;
 
+template <class T>
+uint64_t ns(T x, T y) {
+  return static_cast<uint64_t>(duration_cast<nanoseconds>(y - x).count());
+}
+
+/// Busy loop running `n` iterations.
+int spin(uint64_t n) {
+  int result = 0;
+  for (uint64_t i = 0; i < n; ++i) {
+    ++result;
+    // keeps the optimizer from folding the loop into a constant
+    asm volatile("" : "+r"(result));
+  }
+  return result;
+}
+
+/// Iterations of `spin` per work unit of `impl7` to `impl10`.
+constexpr uint64_t unit_iterations = 50000;
+
+/// Replies `(result, value, queueing delay in ns, busy time in ns)` to each
+/// task, where the queueing delay is the time between stamping the task and
+/// starting to work on it. A `task` has a complexity of 2^x * 5M iterations,
+/// a `work` message carries a linear number of units.
 behavior task_worker(event_based_actor* self) {
   aout(self) << self->id() << " task_worker_" << self->id() << endl;
   return {
-    [=](task_atom, int complexity, hrc::time_point) -> int {
-      //aout(self) << "delay until received: " << ms(ts, hrc::now()) << endl;
+    [=](task_atom, int complexity, hrc::time_point ts) {
+      auto start = hrc::now();
       int result = 0;
       auto x = uint64_t{1} << complexity;
-      for (uint64_t j = 0; j < x; ++j) {
-        for (int i = 0; i < 5000000; ++i) {
-          ++result;
-        }
-      }
-      return result;
+      for (uint64_t j = 0; j < x; ++j)
+        result += spin(5000000);
+      auto done = hrc::now();
+      return make_message(result_atom::value, result, ns(ts, start),
+                          ns(start, done));
+    },
+    [=](work_atom, uint64_t units, hrc::time_point ts) {
+      auto start = hrc::now();
+      auto result = spin(units * unit_iterations);
+      auto done = hrc::now();
+      return make_message(result_atom::value, result, ns(ts, start),
+                          ns(start, done));
+    }
+  };
+}
+
+/// One stage of a pipeline: works `units` on each item and forwards it to
+/// `next`. The last stage reports the item to `next` like a `task_worker`,
+/// where the queueing delay is the end-to-end latency minus the busy time
+/// of all stages.
+behavior pipeline_stage(event_based_actor* self, actor next, uint64_t units,
+                        bool last) {
+  aout(self) << self->id() << " pipeline_stage_" << self->id() << endl;
+  return {
+    [=](stage_atom, hrc::time_point ts, uint64_t busy_ns) {
+      auto start = hrc::now();
+      auto result = spin(units * unit_iterations);
+      auto done = hrc::now();
+      auto busy = busy_ns + ns(start, done);
+      if (last)
+        self->send(next, result_atom::value, result, ns(ts, done) - busy,
+                   busy);
+      else
+        self->send(next, stage_atom::value, ts, busy);
     }
   };
 }
@@ -92,11 +158,44 @@ bool mandatory_missing(std::set<std::string> opts,
   return std::any_of(xs.begin(), xs.end(), not_in_opts);
 }
 
+/// Parameters of `impl7` to `impl10`.
+struct workload_params {
+  /// Work units per task.
+  uint64_t units = 100;
+  /// Weight of the heavy branch in the fork-join workload.
+  uint64_t skew = 100;
+  /// Number of stages per pipeline.
+  size_t stages = 32;
+  /// Number of concurrent pipelines.
+  size_t pipelines = 4;
+  /// Target rate of the open-loop arrivals per second.
+  size_t rate = 10000;
+  /// Number of tasks arriving at once.
+  size_t burst = 100;
+  /// Number of mostly idle actors.
+  size_t idle_actors = 100000;
+};
+
+constexpr int num_workloads = 10;
+
+/// Grid of scheduler settings for `--sweep`, each a comma-separated list.
+struct sweep_params {
+  bool enabled = false;
+  std::string workloads = "0,1,2,3,4,5,6,7,8,9";
+  /// Defaults to powers of two up to the number of hardware threads.
+  std::string threads;
+  /// Messages per actor run, "max" for no limit.
+  std::string throughput = "1,10,100,max";
+  /// Work-stealing polling presets, see `apply_polling`.
+  std::string polling = "default,spin,sleep";
+};
+
 bool setup(int argc, char** argv, std::string& labels_output_file,
-           int& workload, actor_system_config& cfg) {
+           int& workload, workload_params& params, sweep_params& sweep,
+           actor_system_config& cfg) {
   std::string profiler_output_file;
   size_t profiler_resolution_ms = 100;
-  size_t scheduler_threads = std::thread::hardware_concurrency();
+  size_t scheduler_threads = topology::local().usable_cpus();
   size_t max_msg_per_run = std::numeric_limits<size_t>::max();
   auto res = message_builder{argv + 1, argv + argc}.extract_opts({
     {"output,o", "output file for profiler (mandatory)", profiler_output_file},
@@ -104,49 +203,117 @@ bool setup(int argc, char** argv, std::string& labels_output_file,
     {"resolution,r", "profiler resolution in ms", profiler_resolution_ms},
     {"threads,t", "number of threads for the scheduler", scheduler_threads},
     {"max-msgs,m", "number of messages per actor run", max_msg_per_run},
-    {"workload,w", "select workload to bench (1-10) (mandatory)", workload}
+    {"workload,w", "select workload to bench (0-9) (mandatory)", workload},
+    {"units", "work units per task (workloads 6-9)", params.units},
+    {"skew", "weight of the heavy fork-join branch (workload 6)",
+     params.skew},
+    {"stages", "stages per pipeline (workload 7)", params.stages},
+    {"pipelines", "number of pipelines (workload 7)", params.pipelines},
+    {"rate", "arrivals per second (workload 8)", params.rate},
+    {"burst", "tasks per burst (workload 8)", params.burst},
+    {"idle-actors", "number of idle actors (workload 9)", params.idle_actors},
+    {"sweep,s", "run workloads on a grid of scheduler settings without "
+                "profiler, output and labels are optional"},
+    {"sweep-workloads", "workloads for --sweep", sweep.workloads},
+    {"sweep-threads", "thread counts for --sweep", sweep.threads},
+    {"sweep-throughput", "max. messages per actor run for --sweep",
+     sweep.throughput},
+    {"sweep-polling", "work-stealing polling presets for --sweep "
+                      "(default|spin|sleep)", sweep.polling}
   });
+  sweep.enabled = res.opts.count("sweep") > 0;
   if (!res.error.empty() || res.opts.count("help") > 0
       || !res.remainder.empty()
-      || mandatory_missing(res.opts, {"output", "labels", "workload"})) {
+      || (!sweep.enabled
+          && mandatory_missing(res.opts, {"output", "labels", "workload"}))) {
     return cout << res.error << endl << res.helptext << endl, false;
   }
+  if (sweep.enabled)
+    return true;
   cfg.scheduler_enable_profiling = true;
   cfg.scheduler_profiling_ms_resolution = profiler_resolution_ms;
   cfg.scheduler_max_threads = scheduler_threads;
   cfg.scheduler_max_throughput = max_msg_per_run;
-  if (workload < 0 || workload > 5)
+  if (workload < 0 || workload >= num_workloads)
     return false;
   return true;
 }
 
 CAF_ALLOW_UNSAFE_MESSAGE_TYPE(decltype(hrc::now()))
 
+/// Collects the replies of all `task_worker` of one workload.
+class task_stats {
+public:
+  void add(uint64_t queue_ns, uint64_t busy_ns) {
+    queue_delays_.add(queue_ns);
+    busy_ += busy_ns;
+  }
+
+  size_t count() const {
+    return queue_delays_.count();
+  }
+
+  uint64_t busy() const {
+    return busy_;
+  }
+
+  uint64_t queue_delay(double p) {
+    return queue_delays_.percentile(p);
+  }
+
+private:
+  sample_set queue_delays_;
+  uint64_t busy_ = 0;
+};
+
+/// Blocks until `self` received the replies for `tasks` tasks and the
+/// results of `trees` trees of `recursive_worker`.
+void await_completion(scoped_actor& self, size_t tasks, size_t trees,
+                      task_stats& stats) {
+  while (tasks > 0 || trees > 0) {
+    self->receive(
+      [&](result_atom, int, uint64_t queue_ns, uint64_t busy_ns) {
+        stats.add(queue_ns, busy_ns);
+        --tasks;
+      },
+      [&](result_atom, uint32_t) {
+        --trees;
+      }
+    );
+  }
+}
+
 /// Spawn 20 `task_worker` and give them work,
 /// the work has variation in its complexity (0 to 4)
-void impl1(actor_system& system) {
+void impl1(actor_system& system, const workload_params&,
+           task_stats& stats) {
+  scoped_actor self{system};
   vector<actor> workers;
   for (int i = 0; i < 20; ++i)
     workers.push_back(system.spawn<lazy_init>(task_worker));
   for (int j = 0; j < 10; ++j)
     for (int i = 0; i < 5; ++i)
       for (auto& w : workers)
-        anon_send(w, task_atom::value, i, hrc::now());
+        self->send(w, task_atom::value, i, hrc::now());
+  await_completion(self, 10 * 5 * workers.size(), 0, stats);
   for (auto& w : workers)
     anon_send_exit(w, exit_reason::user_shutdown);
 }
 
 /// Spawn 2^15 `recursive_worker`
-void impl2(actor_system& system) {
+void impl2(actor_system& system, const workload_params&,
+           task_stats& stats) {
   scoped_actor self{system};
   auto root = system.spawn(recursive_worker, self);
   anon_send(root, task_atom::value, uint32_t{15});
+  await_completion(self, 0, 1, stats);
 }
 
 /// Spawn 20 `task_worker`and give them work,
 /// the work has variation in its complexity (0 to 4)
 /// In addition, this will spawn 2^15 `recursive_worker`
-void impl3(actor_system& system) {
+void impl3(actor_system& system, const workload_params&,
+           task_stats& stats) {
   scoped_actor self{system};
   vector<actor> workers;
   for (int i = 0; i < 20; ++i)
@@ -154,37 +321,41 @@ void impl3(actor_system& system) {
   for (int j = 0; j < 10; ++j)
     for (int i = 0; i < 5; ++i)
       for (auto& w : workers)
-        anon_send(w, task_atom::value, i, hrc::now());
+        self->send(w, task_atom::value, i, hrc::now());
   auto root = system.spawn(recursive_worker, self);
   anon_send(root, task_atom::value, uint32_t{15});
+  await_completion(self, 10 * 5 * workers.size(), 1, stats);
   for (auto& w : workers)
     anon_send_exit(w, exit_reason::user_shutdown);
-  anon_send_exit(root, exit_reason::user_shutdown);
 }
 
 /// Spawn 5 `task_worker` and give them work
 /// then spawn 2^15 `recursive_worker`. This is
 /// repeated 10 times.
-void impl4(actor_system& system) {
+void impl4(actor_system& system, const workload_params&,
+           task_stats& stats) {
   scoped_actor self{system};
   vector<actor> workers;
+  size_t tasks = 0;
   for (int j = 0; j < 10; ++j) {
     for (int i = 0; i < 5; ++i)
       for (auto& w : workers)
-        anon_send(w, task_atom::value, i, hrc::now());
+        self->send(w, task_atom::value, i, hrc::now());
+    tasks += 5 * workers.size();
     auto root = system.spawn(recursive_worker, self);
     anon_send(root, task_atom::value, uint32_t{15});
     for (int i = 0; i < 5; ++i)
       workers.push_back(system.spawn<lazy_init>(task_worker));
-    anon_send_exit(root, exit_reason::user_shutdown);
   }
+  await_completion(self, tasks, 10, stats);
   for (auto& w : workers)
     anon_send_exit(w, exit_reason::user_shutdown);
 }
 
 /// Spawn 5 `recursive_worker` in an actor pool
 /// after that, 5 `task_worker` are spawnend in an actor pool
-void impl5(actor_system& system) {
+void impl5(actor_system& system, const workload_params&,
+           task_stats& stats) {
   scoped_actor self{system};
   auto factory = [&] {
     return system.spawn(recursive_worker, self);
@@ -199,17 +370,22 @@ void impl5(actor_system& system) {
                                 5, factory_task, actor_pool::broadcast());
   for (int j = 0; j < 10; ++j) {
     for (int i = 0; i < 9; ++i) {
-      anon_send(pool2, task_atom::value, i, hrc::now());
+      self->send(pool2, task_atom::value, i, hrc::now());
     }
   }
+  // the pools broadcast each message to all of their 5 workers
+  await_completion(self, 10 * 9 * 5, 5, stats);
+  anon_send_exit(pool, exit_reason::user_shutdown);
   anon_send_exit(pool2, exit_reason::user_shutdown);
 }
 
 /// Spawn either 2^15 `recursive_worker` or a actor pool with 10 actors
 /// of `task_worker` type. This is repeated 20 times, on every even count this
 /// workload will spawn `recursive_worker`, on odd count `task_worker`.
-void impl6(actor_system& system) {
+void impl6(actor_system& system, const workload_params&,
+           task_stats& stats) {
   scoped_actor self{system};
+  vector<actor> pools;
   for (int i = 0; i < 20; ++i) {
     if (i % 2) {
       anon_send(system.spawn(recursive_worker, self),
@@ -218,21 +394,309 @@ void impl6(actor_system& system) {
       auto pool = actor_pool::make(system.dummy_execution_unit(), 10,
                                    [&]{ return system.spawn(task_worker); },
                                    actor_pool::broadcast());
-      anon_send(pool, task_atom::value, i, hrc::now());
-      anon_send_exit(pool, exit_reason::user_shutdown);
+      self->send(pool, task_atom::value, i % 5, hrc::now());
+      pools.push_back(pool);
+    }
+  }
+  await_completion(self, 10 * 10, 10, stats);
+  for (auto& pool : pools)
+    anon_send_exit(pool, exit_reason::user_shutdown);
+}
+
+/// Fork-join with 20 `task_worker` for 10 rounds, each round waits for all
+/// branches. One branch per round is `skew` times heavier than the others,
+/// i.e., all other workers idle until the straggler finishes.
+void impl7(actor_system& system, const workload_params& params,
+           task_stats& stats) {
+  scoped_actor self{system};
+  vector<actor> workers;
+  for (int i = 0; i < 20; ++i)
+    workers.push_back(system.spawn<lazy_init>(task_worker));
+  for (size_t round = 0; round < 10; ++round) {
+    for (size_t i = 0; i < workers.size(); ++i) {
+      // rotate the heavy branch to not always hit the same worker
+      auto units = i == round % workers.size() ? params.units * params.skew
+                                                : params.units;
+      self->send(workers[i], work_atom::value, units, hrc::now());
+    }
+    await_completion(self, workers.size(), 0, stats);
+  }
+  for (auto& w : workers)
+    anon_send_exit(w, exit_reason::user_shutdown);
+}
+
+/// Spawn `pipelines` chains of `stages` `pipeline_stage` and push 1000
+/// items through each, where every stage works `units / stages` units per
+/// item, i.e., one item costs about as much as one task of the other
+/// workloads.
+void impl8(actor_system& system, const workload_params& params,
+           task_stats& stats) {
+  scoped_actor self{system};
+  if (params.stages == 0)
+    return;
+  auto units = std::max(params.units / params.stages, uint64_t{1});
+  vector<actor> heads;
+  vector<actor> all_stages;
+  for (size_t i = 0; i < params.pipelines; ++i) {
+    actor next{self};
+    bool last = true;
+    for (size_t j = 0; j < params.stages; ++j) {
+      next = system.spawn<lazy_init>(pipeline_stage, next, units, last);
+      all_stages.push_back(next);
+      last = false;
+    }
+    heads.push_back(next);
+  }
+  constexpr size_t items = 1000;
+  for (size_t i = 0; i < items; ++i)
+    for (auto& head : heads)
+      anon_send(head, stage_atom::value, hrc::now(), uint64_t{0});
+  await_completion(self, items * heads.size(), 0, stats);
+  for (auto& stage : all_stages)
+    anon_send_exit(stage, exit_reason::user_shutdown);
+}
+
+/// Open-loop arrivals at `rate` tasks per second in bursts of `burst` tasks,
+/// distributed round-robin over 20 `task_worker`, for 10000 tasks. New
+/// bursts arrive on schedule regardless of whether earlier tasks finished.
+void impl9(actor_system& system, const workload_params& params,
+           task_stats& stats) {
+  scoped_actor self{system};
+  if (params.rate == 0 || params.burst == 0)
+    return;
+  vector<actor> workers;
+  for (int i = 0; i < 20; ++i)
+    workers.push_back(system.spawn<lazy_init>(task_worker));
+  constexpr size_t tasks = 10000;
+  auto interval = duration_cast<hrc::duration>(
+    std::chrono::duration<double>(static_cast<double>(params.burst)
+                                  / static_cast<double>(params.rate)));
+  auto next_burst = hrc::now();
+  size_t sent = 0;
+  while (sent < tasks) {
+    std::this_thread::sleep_until(next_burst);
+    next_burst += interval;
+    for (size_t i = 0; i < params.burst && sent < tasks; ++i, ++sent)
+      self->send(workers[sent % workers.size()], work_atom::value,
+                 params.units, hrc::now());
+  }
+  await_completion(self, tasks, 0, stats);
+  for (auto& w : workers)
+    anon_send_exit(w, exit_reason::user_shutdown);
+}
+
+/// Spawn `idle_actors` `task_worker` and wake 100 random ones every 10ms for
+/// 100 rounds, i.e., the scheduler mostly sleeps and each wakeup hits cold
+/// actors.
+void impl10(actor_system& system, const workload_params& params,
+            task_stats& stats) {
+  scoped_actor self{system};
+  if (params.idle_actors == 0)
+    return;
+  vector<actor> workers;
+  workers.reserve(params.idle_actors);
+  for (size_t i = 0; i < params.idle_actors; ++i)
+    workers.push_back(system.spawn<lazy_init>(task_worker));
+  std::mt19937 engine{42};
+  std::uniform_int_distribution<size_t> pick{0, workers.size() - 1};
+  constexpr size_t rounds = 100;
+  constexpr size_t wakeups = 100;
+  for (size_t round = 0; round < rounds; ++round) {
+    for (size_t i = 0; i < wakeups; ++i)
+      self->send(workers[pick(engine)], work_atom::value, params.units,
+                 hrc::now());
+    std::this_thread::sleep_for(milliseconds(10));
+  }
+  await_completion(self, rounds * wakeups, 0, stats);
+  for (auto& w : workers)
+    anon_send_exit(w, exit_reason::user_shutdown);
+}
+
+using implfun = void (*)(actor_system&, const workload_params&,
+                         task_stats&);
+
+implfun workloads[] = {impl1, impl2, impl3, impl4, impl5,
+                       impl6, impl7, impl8, impl9, impl10};
+
+static_assert(sizeof(workloads) / sizeof(implfun) == num_workloads,
+              "num_workloads out of sync");
+
+/// Makespan in ns and task statistics of one run.
+struct run_result {
+  uint64_t makespan = 0;
+  task_stats stats;
+};
+
+run_result run_workload(actor_system_config& cfg, int workload,
+                        const workload_params& params,
+                        const std::string& labels_output_file,
+                        thread_placement& placement) {
+  run_result result;
+  hrc::time_point start;
+  hrc::time_point stop;
+  { // scope for the actor system, its destructor waits for all actors
+    placement.prepare();
+    actor_system system(cfg);
+    placement.apply(cfg.scheduler_max_threads);
+    actor_ostream::redirect_all(system, labels_output_file);
+    start = hrc::now();
+    workloads[workload](system, params, result.stats);
+    stop = hrc::now();
+  }
+  result.makespan = ns(start, stop);
+  return result;
+}
+
+double utilization(const run_result& x, size_t threads) {
+  return 100.0 * static_cast<double>(x.stats.busy())
+         / (static_cast<double>(x.makespan) * static_cast<double>(threads));
+}
+
+double us(uint64_t x) {
+  return static_cast<double>(x) / 1000.0;
+}
+
+/// Parses a comma-separated list of numbers, where "max" stands for the
+/// largest value of `T`.
+template <class T>
+bool parse_list(const std::string& str, vector<T>& result) {
+  std::istringstream in{str};
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    if (item == "max") {
+      result.push_back(std::numeric_limits<T>::max());
+      continue;
+    }
+    char* end = nullptr;
+    auto x = strtoull(item.c_str(), &end, 10);
+    if (item.empty() || *end != '\0') {
+      cerr << "not a number: " << item << endl;
+      return false;
+    }
+    result.push_back(static_cast<T>(x));
+  }
+  return !result.empty();
+}
+
+/// Applies a named set of work-stealing polling settings: "default" keeps
+/// the CAF defaults, "spin" keeps idle workers polling for a long time
+/// before sleeping and "sleep" sends them to the relaxed (10ms) sleep
+/// almost immediately.
+bool apply_polling(actor_system_config& cfg, const std::string& name) {
+  if (name == "default")
+    return true;
+  if (name == "spin") {
+    cfg.work_stealing_aggressive_poll_attempts = 10000;
+    cfg.work_stealing_moderate_poll_attempts = 10000;
+    cfg.work_stealing_moderate_sleep_duration_us = 10;
+    return true;
+  }
+  if (name == "sleep") {
+    cfg.work_stealing_aggressive_poll_attempts = 1;
+    cfg.work_stealing_moderate_poll_attempts = 1;
+    return true;
+  }
+  return false;
+}
+
+/// Runs every selected workload under both scheduler policies for each
+/// combination of thread count, throughput and (for work stealing) polling
+/// preset and prints one row per run.
+int run_sweep(const sweep_params& sweep, const workload_params& params,
+              std::string labels_output_file, thread_placement& placement) {
+  vector<int> ids;
+  vector<size_t> threads;
+  vector<size_t> throughputs;
+  vector<std::string> polls;
+  if (sweep.threads.empty()) {
+    size_t hw = topology::local().usable_cpus();
+    for (size_t t = 1; t < hw; t *= 2)
+      threads.push_back(t);
+    threads.push_back(hw);
+  } else if (!parse_list(sweep.threads, threads)) {
+    return 1;
+  }
+  if (!parse_list(sweep.workloads, ids)
+      || !parse_list(sweep.throughput, throughputs))
+    return 1;
+  std::istringstream in{sweep.polling};
+  for (std::string item; std::getline(in, item, ',');) {
+    actor_system_config dummy;
+    if (!apply_polling(dummy, item)) {
+      cerr << "unknown polling preset: " << item << endl;
+      return 1;
+    }
+    polls.push_back(item);
+  }
+  for (auto id : ids) {
+    if (id < 0 || id >= num_workloads) {
+      cerr << "invalid workload: " << id << endl;
+      return 1;
+    }
+  }
+  // task_worker prints a label per actor, which only the profiler needs
+  if (labels_output_file.empty())
+    labels_output_file = "/dev/null";
+  cout << setw(8) << "workload" << setw(10) << "policy" << setw(8) << "threads"
+       << setw(11) << "throughput" << setw(9) << "polling"
+       << setw(13) << "makespan_ms" << setw(8) << "tasks"
+       << setw(11) << "p50_us" << setw(11) << "p90_us" << setw(11) << "p99_us"
+       << setw(11) << "max_us" << setw(8) << "util_%" << endl;
+  vector<std::string> no_polling{"-"};
+  for (auto id : ids) {
+    for (auto policy : {atom("stealing"), atom("sharing")}) {
+      auto stealing = policy == atom("stealing");
+      for (auto t : threads) {
+        for (auto tp : throughputs) {
+          for (auto& poll : stealing ? polls : no_polling) {
+            actor_system_config cfg;
+            cfg.scheduler_enable_profiling = false;
+            cfg.scheduler_policy = policy;
+            cfg.scheduler_max_threads = t;
+            cfg.scheduler_max_throughput = tp;
+            apply_polling(cfg, poll);
+            auto res = run_workload(cfg, id, params, labels_output_file,
+                                    placement);
+            auto& st = res.stats;
+            cout << setw(8) << id << setw(10) << to_string(policy)
+                 << setw(8) << t << setw(11)
+                 << (tp == std::numeric_limits<size_t>::max()
+                     ? std::string{"max"} : std::to_string(tp))
+                 << setw(9) << poll << fixed << setprecision(1)
+                 << setw(13) << us(res.makespan) / 1000.0
+                 << setw(8) << st.count()
+                 << setw(11) << us(st.queue_delay(0.5))
+                 << setw(11) << us(st.queue_delay(0.9))
+                 << setw(11) << us(st.queue_delay(0.99))
+                 << setw(11) << us(st.queue_delay(1.0))
+                 << setw(8) << utilization(res, t) << endl;
+          }
+        }
+      }
     }
   }
+  return 0;
 }
 
 int main(int argc, char** argv) {
+  auto placement = thread_placement::from_args(argc, argv);
   int workload = 0;
+  workload_params params;
+  sweep_params sweep;
   actor_system_config cfg;
   std::string labels_output_file;
-  if (!setup(argc, argv, labels_output_file, workload, cfg))
+  if (!setup(argc, argv, labels_output_file, workload, params, sweep, cfg))
     return 1;
-  actor_system system(cfg);
-  actor_ostream::redirect_all(system, labels_output_file);
-  using implfun = void (*)(actor_system&);
-  implfun funs[] = {impl1, impl2, impl3, impl4, impl5, impl6};
-  funs[workload](system);
+  if (sweep.enabled)
+    return run_sweep(sweep, params, labels_output_file, placement);
+  auto res = run_workload(cfg, workload, params, labels_output_file,
+                          placement);
+  auto& stats = res.stats;
+  cout << "makespan (ms): " << us(res.makespan) / 1000.0 << endl
+       << "tasks: " << stats.count() << ", queueing delay (us): p50 "
+       << us(stats.queue_delay(0.5)) << ", p99 "
+       << us(stats.queue_delay(0.99)) << ", max "
+       << us(stats.queue_delay(1.0)) << endl
+       << "utilization (task_worker busy time / makespan / threads): "
+       << utilization(res, cfg.scheduler_max_threads) << " %" << endl;
 }
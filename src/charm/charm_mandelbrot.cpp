@@ -1,5 +1,6 @@
 #include <vector>
 #include <iostream>
+#include <algorithm>
 
 #include "charm++.h"
 #include "charm_mandelbrot.decl.h"
@@ -10,19 +11,41 @@ namespace {
 size_t m_counter;
 std::vector<byte>   m_buffer;
 std::vector<double> m_cr0;
+
+// Adler-32 (RFC 1950) of the image with padding bits of each row cleared,
+// matches the checksum printed by all other implementations
+unsigned adler32(size_t width) {
+  size_t max_x = (width + 7) / 8;
+  byte mask = width % 8 == 0 ? 0xFF : static_cast<byte>(0xFF << (8 - width % 8));
+  unsigned a = 1;
+  unsigned b = 0;
+  for (size_t i = 0; i < m_buffer.size(); ++i) {
+    byte x = m_buffer[i];
+    if (i % max_x == max_x - 1)
+      x &= mask;
+    a = (a + x) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
 }
 
 class main : public CBase_main {
  public:
   main(CkArgMsg* m) {
-    if (m->argc != 2) {
+    if (m->argc != 2 && m->argc != 3) {
       std::cout << std::endl
-                << "./charm_mandelbrot PIXELS_PER_DIMENSION"
+                << "./charm_mandelbrot PIXELS_PER_DIMENSION [ROWS_PER_CHARE]"
                 << std::endl << std::endl;
       CkExit();
     }
     int N = atoi(m->argv[1]);
+    int grain = m->argc == 3 ? atoi(m->argv[2]) : 1;
     delete m;
+    if (grain < 1) {
+      std::cout << "ROWS_PER_CHARE must be positive" << std::endl;
+      CkExit();
+    }
     int max_x = (N + 7) / 8;
     int max_iterations = 250;
     double limit = 2.0;
@@ -38,8 +61,9 @@ class main : public CBase_main {
     }
     int num = CkNumPes();
     int pe = 0;
-    for (int y = 0; y < N; ++y) {
-      CProxy_worker w = CProxy_worker::ckNew(N, max_x, max_iterations, limit_sq, ++pe % num);
+    for (int y = 0; y < N; y += grain) {
+      CProxy_worker w = CProxy_worker::ckNew(N, max_x, max_iterations, limit_sq,
+                                             grain, ++pe % num);
       w.calc(y);
     }
     CkPrintf("%s", "main done\n");
@@ -52,17 +76,35 @@ class worker : public CBase_worker {
   int                        m_max_x;
   int                        m_max_iters;
   double                     m_limit_sq;
+  int                        m_grain;
 
  public:
-  worker(int N, int max_x, int max_iters, double limit_sq)
+  worker(int N, int max_x, int max_iters, double limit_sq, int grain)
     : m_dim(N),
       m_max_x(max_x),
       m_max_iters(max_iters),
-      m_limit_sq(limit_sq) {
+      m_limit_sq(limit_sq),
+      m_grain(grain) {
     // nop
   }
 
-  void calc(int row) {
+  // computes `m_grain` rows starting at `first_row`
+  void calc(int first_row) {
+    int last_row = std::min(first_row + m_grain, m_dim);
+    for (int row = first_row; row < last_row; ++row)
+      calc_row(row);
+    size_t num_rows = static_cast<size_t>(last_row - first_row);
+    size_t dim = static_cast<size_t>(m_dim);
+    delete this; // members are no longer accessible
+    if (__sync_add_and_fetch(&m_counter, num_rows) == dim) {
+      // done
+      CkPrintf("checksum: %u\n", adler32(dim));
+      CkExit();
+    }
+  }
+
+ private:
+  void calc_row(int row) {
     /*
     if (row < m_dim) {
       CProxy_worker w = CProxy_worker::ckNew(m_dim, m_max_x, m_max_iters, m_limit_sq);
@@ -99,19 +141,6 @@ class worker : public CBase_worker {
       }
       line[x] = bits;
     }
-    delete this;
-    if (__sync_add_and_fetch(&m_counter, 1) == m_dim) {
-      /*
-      FILE* out = fopen("chaming mandelbrot.bmp", "wb");
-      fprintf(out, "P4\n%u %u\n", m_dim, m_dim);
-      fwrite(&m_buffer[0], m_buffer.size(), 1, out);
-      if (out != stdout) {
-        fclose(out);
-      }
-      */
-      // done
-      CkExit();
-    }
   }
 };
 
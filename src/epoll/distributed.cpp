@@ -0,0 +1,1137 @@
+/******************************************************************************
+ *                       ____    _    _____                                   *
+ *                      / ___|  / \  |  ___|    C++                           *
+ *                     | |     / _ \ | |_       Actor                         *
+ *                     | |___ / ___ \|  _|      Framework                     *
+ *                      \____/_/   \_|_|                                      *
+ *                                                                            *
+ * Copyright (C) 2011 - 2017                                                  *
+ * Dominik Charousset <dominik.charousset (at) haw-hamburg.de>                *
+ *                                                                            *
+ * Distributed under the terms and conditions of the BSD 3-Clause License or  *
+ * (at your option) under the terms and conditions of the Boost Software      *
+ * License 1.0. See accompanying files LICENSE and LICENSE_ALTERNATIVE.       *
+ *                                                                            *
+ * If you did not receive a copy of the license files, see                    *
+ * http://opensource.org/licenses/BSD-3-Clause and                            *
+ * http://www.boost.org/LICENSE_1_0.txt.                                      *
+ ******************************************************************************/
+
+// Baseline for src/caf/distributed.cpp without actors: every node is a single
+// thread running an epoll loop and exchanges length-prefixed frames over
+// plain TCP. Modes, options, message counts and the output format are the
+// same as in the CAF version, i.e., the difference between both is the cost
+// of the middleman, serialization and scheduling.
+
+#include <poll.h>
+#include <sched.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+
+#include <map>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <utility>
+#include <iostream>
+#include <algorithm>
+
+#include "topology.hpp"
+#include "sample_set.hpp"
+
+using namespace std;
+
+using hrc = std::chrono::high_resolution_clock;
+
+namespace {
+
+using node = pair<string, uint16_t>;
+
+// first byte of each frame body
+enum msg_type : uint8_t {
+  ping_msg,
+  pong_msg,
+  add_pong_msg,
+  ok_msg,
+  error_msg,
+  kickoff_msg,
+  done_msg,
+  stats_msg,
+  purge_msg,
+  shutdown_msg
+};
+
+// appends a frame to a buffer: a 4-byte length of the body in network byte
+// order followed by the body, integers are big endian as well
+class frame_writer {
+public:
+  frame_writer(string& buf, msg_type type) : buf_(buf), start_(buf.size()) {
+    buf_.append(4, '\0');
+    put<uint8_t>(type);
+  }
+
+  ~frame_writer() {
+    auto len = htonl(static_cast<uint32_t>(buf_.size() - start_ - 4));
+    memcpy(&buf_[start_], &len, sizeof(len));
+  }
+
+  template <class T>
+  frame_writer& put(T x) {
+    for (auto i = sizeof(T); i > 0; --i)
+      buf_ += static_cast<char>((x >> ((i - 1) * 8)) & 0xFF);
+    return *this;
+  }
+
+  frame_writer& put(const string& x) {
+    put(static_cast<uint32_t>(x.size()));
+    buf_ += x;
+    return *this;
+  }
+
+private:
+  string& buf_;
+  size_t start_;
+};
+
+// reads the fields of one frame body, sets `ok` to false on truncated input
+class frame_reader {
+public:
+  frame_reader(const char* data, size_t size) : pos_(data), end_(data + size) {
+    // nop
+  }
+
+  bool ok = true;
+
+  template <class T>
+  T get() {
+    T result = 0;
+    if (static_cast<size_t>(end_ - pos_) < sizeof(T)) {
+      ok = false;
+      return result;
+    }
+    for (size_t i = 0; i < sizeof(T); ++i)
+      result = static_cast<T>((result << 8) | static_cast<uint8_t>(*pos_++));
+    return result;
+  }
+
+  string get_string() {
+    auto len = get<uint32_t>();
+    if (!ok || static_cast<size_t>(end_ - pos_) < len) {
+      ok = false;
+      return {};
+    }
+    string result{pos_, len};
+    pos_ += len;
+    return result;
+  }
+
+private:
+  const char* pos_;
+  const char* end_;
+};
+
+// splits complete frames off the front of `buf` and calls `f` with their
+// body; returns false if `f` does
+template <class F>
+bool consume_frames(string& buf, F f) {
+  size_t pos = 0;
+  bool result = true;
+  while (result && buf.size() - pos >= 4) {
+    uint32_t len;
+    memcpy(&len, buf.data() + pos, sizeof(len));
+    len = ntohl(len);
+    if (buf.size() - pos - 4 < len)
+      break;
+    result = f(frame_reader{buf.data() + pos + 4, len});
+    pos += 4 + len;
+  }
+  buf.erase(0, pos);
+  return result;
+}
+
+// collects the round-trip times of one pinger in nanoseconds
+class rtt_stats {
+public:
+  void add(hrc::time_point sent, hrc::time_point received) {
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+    auto ns = duration_cast<nanoseconds>(received - sent).count();
+    samples_.add(static_cast<uint64_t>(ns));
+  }
+
+  uint64_t count() const {
+    return samples_.count();
+  }
+
+  uint64_t sum() const {
+    return samples_.sum();
+  }
+
+  uint64_t percentile(double p) {
+    return samples_.percentile(p);
+  }
+
+private:
+  sample_set samples_;
+};
+
+// counters of one node telling how much traffic it puts on the wire and how
+// many syscalls it needs for that
+struct wire_sample {
+  uint64_t bytes_out = 0;     // TCP payload bytes sent and acked
+  uint64_t bytes_in = 0;      // TCP payload bytes received
+  uint64_t segments_out = 0;  // TCP segments carrying data
+  uint64_t send_calls = 0;
+  uint64_t recv_calls = 0;
+};
+
+void add_tcp_stats(int fd, wire_sample& x) {
+  tcp_info info;
+  memset(&info, 0, sizeof(info));
+  socklen_t len = sizeof(info);
+  if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0
+      || len < offsetof(tcp_info, tcpi_data_segs_out)
+               + sizeof(info.tcpi_data_segs_out))
+    return;
+  x.bytes_out += info.tcpi_bytes_acked;
+  x.bytes_in += info.tcpi_bytes_received;
+  x.segments_out += info.tcpi_data_segs_out;
+}
+
+void set_nodelay(int fd) {
+  int flag = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+void set_nonblocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// returns a blocking socket connected to `host`:`port` or -1
+int connect_to(const string& host, uint16_t port, string& error) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addrs = nullptr;
+  auto res = getaddrinfo(host.c_str(), to_string(port).c_str(), &hints,
+                         &addrs);
+  if (res != 0) {
+    error = gai_strerror(res);
+    return -1;
+  }
+  int fd = -1;
+  for (auto i = addrs; i != nullptr; i = i->ai_next) {
+    fd = socket(i->ai_family, i->ai_socktype, i->ai_protocol);
+    if (fd < 0)
+      continue;
+    if (connect(fd, i->ai_addr, i->ai_addrlen) == 0)
+      break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addrs);
+  if (fd < 0) {
+    error = "unable to connect to " + host + ":" + to_string(port);
+    return -1;
+  }
+  set_nodelay(fd);
+  return fd;
+}
+
+// returns a listening socket bound to `host`:`port` and stores the actual
+// port in `port`, or returns -1
+int listen_at(const char* host, uint16_t& port) {
+  auto fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  int flag = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &addr.sin_addr) != 1
+      || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+      || listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return -1;
+  }
+  socklen_t len = sizeof(addr);
+  getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+  port = ntohs(addr.sin_port);
+  return fd;
+}
+
+// sends `num_pings + 1` pings over one peer connection, one at a time; the
+// node multiplexes all pingers of all peers on its connections by `id`
+struct pinger {
+  uint64_t conn;
+  rtt_stats rtts;
+  hrc::time_point start;
+  hrc::time_point sent;
+};
+
+// a server node: answers pings of other nodes and runs pingers on behalf of
+// the benchmark client connected to it
+class node_server {
+public:
+  explicit node_server(int listen_fd) : listen_fd_(listen_fd) {
+    epfd_ = epoll_create1(0);
+    set_nonblocking(listen_fd_);
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0; // connection IDs start at 1
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+  }
+
+  ~node_server() {
+    for (auto& kvp : conns_)
+      close(kvp.second.fd);
+    close(listen_fd_);
+    close(epfd_);
+  }
+
+  // runs the event loop until a client sends shutdown
+  void run() {
+    vector<epoll_event> events(64);
+    while (!shutdown_) {
+      auto n = epoll_wait(epfd_, events.data(), static_cast<int>(events.size()),
+                          -1);
+      if (n < 0) {
+        if (errno == EINTR)
+          continue;
+        perror("epoll_wait");
+        return;
+      }
+      for (int i = 0; i < n && !shutdown_; ++i) {
+        auto id = events[i].data.u64;
+        if (id == 0) {
+          accept_all();
+          continue;
+        }
+        if (events[i].events & EPOLLOUT)
+          flush(id);
+        if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+          read_from(id);
+      }
+      // one send per connection and loop iteration batches all frames
+      // produced while handling this round of events
+      for (auto id : dirty_)
+        flush(id);
+      dirty_.clear();
+    }
+  }
+
+private:
+  struct connection {
+    int fd;
+    string in;
+    string out;
+    bool want_write = false;
+  };
+
+  uint64_t add_connection(int fd) {
+    set_nonblocking(fd);
+    auto id = next_id_++;
+    conns_[id].fd = fd;
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = id;
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+    return id;
+  }
+
+  void close_connection(uint64_t id) {
+    auto i = conns_.find(id);
+    if (i == conns_.end())
+      return;
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, i->second.fd, nullptr);
+    close(i->second.fd);
+    conns_.erase(i);
+    for (auto j = pongs_.begin(); j != pongs_.end();) {
+      if (j->second == id)
+        j = pongs_.erase(j);
+      else
+        ++j;
+    }
+  }
+
+  void accept_all() {
+    for (;;) {
+      auto fd = accept(listen_fd_, nullptr, nullptr);
+      if (fd < 0)
+        return;
+      set_nodelay(fd);
+      add_connection(fd);
+    }
+  }
+
+  // returns the output buffer of `id` for appending frames
+  string* output(uint64_t id) {
+    auto i = conns_.find(id);
+    if (i == conns_.end())
+      return nullptr;
+    dirty_.push_back(id);
+    return &i->second.out;
+  }
+
+  void flush(uint64_t id) {
+    auto i = conns_.find(id);
+    if (i == conns_.end())
+      return;
+    auto& c = i->second;
+    if (c.out.empty())
+      return;
+    ++send_calls_;
+    auto n = ::send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        close_connection(id);
+        return;
+      }
+      n = 0;
+    }
+    c.out.erase(0, static_cast<size_t>(n));
+    // wait for EPOLLOUT only while the kernel buffer is full
+    if (c.out.empty() == c.want_write) {
+      c.want_write = !c.out.empty();
+      epoll_event ev;
+      ev.events = c.want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+      ev.data.u64 = id;
+      epoll_ctl(epfd_, EPOLL_CTL_MOD, c.fd, &ev);
+    }
+  }
+
+  void read_from(uint64_t id) {
+    char buf[65536];
+    for (;;) {
+      auto i = conns_.find(id);
+      if (i == conns_.end())
+        return;
+      ++recv_calls_;
+      auto n = ::recv(i->second.fd, buf, sizeof(buf), 0);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+      if (n <= 0) {
+        close_connection(id);
+        return;
+      }
+      i->second.in.append(buf, static_cast<size_t>(n));
+      if (!consume_frames(i->second.in,
+                          [&](frame_reader rd) { return handle(id, rd); })) {
+        close_connection(id);
+        return;
+      }
+      // a partially filled buffer means the socket is drained
+      if (static_cast<size_t>(n) < sizeof(buf))
+        return;
+    }
+  }
+
+  // handles one frame received on connection `id`, returns false on
+  // malformed input
+  bool handle(uint64_t id, frame_reader& rd) {
+    auto type = rd.get<uint8_t>();
+    switch (type) {
+      case ping_msg: {
+        auto pinger_id = rd.get<uint32_t>();
+        auto value = rd.get<uint32_t>();
+        auto payload = rd.get_string();
+        if (!rd.ok)
+          return false;
+        if (auto out = output(id))
+          frame_writer{*out, pong_msg}.put(pinger_id).put(value).put(payload);
+        return true;
+      }
+      case pong_msg: {
+        auto pinger_id = rd.get<uint32_t>();
+        auto value = rd.get<uint32_t>();
+        rd.get_string();
+        if (!rd.ok || pinger_id >= pingers_.size())
+          return false;
+        on_pong(pinger_id, value);
+        return true;
+      }
+      case add_pong_msg: {
+        auto host = rd.get_string();
+        auto port = rd.get<uint16_t>();
+        if (!rd.ok)
+          return false;
+        auto key = make_pair(host, port);
+        string error;
+        if (pongs_.count(key) == 0) {
+          auto fd = connect_to(host, port, error);
+          if (fd >= 0)
+            pongs_.emplace(key, add_connection(fd));
+        }
+        if (auto out = output(id)) {
+          if (error.empty())
+            frame_writer{*out, ok_msg};
+          else
+            frame_writer{*out, error_msg}.put(error);
+        }
+        return true;
+      }
+      case kickoff_msg: {
+        auto num_pings = rd.get<uint32_t>();
+        node_id_ = rd.get<uint32_t>();
+        auto payload_size = rd.get<uint32_t>();
+        auto ping_actors = rd.get<uint32_t>();
+        if (!rd.ok)
+          return false;
+        client_ = id;
+        payload_.assign(payload_size, 'x');
+        pingers_.clear();
+        auto now = hrc::now();
+        for (auto& kvp : pongs_) {
+          for (uint32_t i = 0; i < ping_actors; ++i) {
+            auto pinger_id = static_cast<uint32_t>(pingers_.size());
+            pingers_.push_back(pinger{kvp.second, {}, now, now});
+            if (auto out = output(kvp.second))
+              frame_writer{*out, ping_msg}.put(pinger_id).put(num_pings)
+                                          .put(payload_);
+          }
+        }
+        return true;
+      }
+      case stats_msg: {
+        wire_sample x;
+        for (auto& kvp : conns_)
+          add_tcp_stats(kvp.second.fd, x);
+        x.send_calls = send_calls_;
+        x.recv_calls = recv_calls_;
+        if (auto out = output(id))
+          frame_writer{*out, stats_msg}.put(x.bytes_out).put(x.bytes_in)
+                                       .put(x.segments_out).put(x.send_calls)
+                                       .put(x.recv_calls);
+        return true;
+      }
+      case purge_msg: {
+        auto pongs = std::move(pongs_);
+        for (auto& kvp : pongs)
+          close_connection(kvp.second);
+        pingers_.clear();
+        return true;
+      }
+      case shutdown_msg:
+        shutdown_ = true;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  void on_pong(uint32_t pinger_id, uint32_t value) {
+    auto& p = pingers_[pinger_id];
+    auto now = hrc::now();
+    p.rtts.add(p.sent, now);
+    if (value == 0) {
+      using std::chrono::duration_cast;
+      using std::chrono::nanoseconds;
+      auto elapsed = duration_cast<nanoseconds>(now - p.start).count();
+      if (auto out = output(client_))
+        frame_writer{*out, done_msg}
+          .put(node_id_).put(p.rtts.count()).put(p.rtts.sum())
+          .put(p.rtts.percentile(0.5)).put(p.rtts.percentile(0.99))
+          .put(p.rtts.percentile(1.0)).put(static_cast<uint64_t>(elapsed));
+      return;
+    }
+    p.sent = now;
+    if (auto out = output(p.conn))
+      frame_writer{*out, ping_msg}.put(pinger_id).put(value - 1).put(payload_);
+  }
+
+  int epfd_;
+  int listen_fd_;
+  uint64_t next_id_ = 1;
+  map<uint64_t, connection> conns_;
+  vector<uint64_t> dirty_;
+  map<node, uint64_t> pongs_;
+  vector<pinger> pingers_;
+  string payload_;
+  uint64_t client_ = 0;
+  uint32_t node_id_ = 0;
+  uint64_t send_calls_ = 0;
+  uint64_t recv_calls_ = 0;
+  bool shutdown_ = false;
+};
+
+// blocking connection of the benchmark client to one node
+class control_channel {
+public:
+  control_channel() : fd_(-1) {
+    // nop
+  }
+
+  control_channel(control_channel&& other) : fd_(other.fd_) {
+    other.fd_ = -1;
+  }
+
+  ~control_channel() {
+    if (fd_ >= 0)
+      close(fd_);
+  }
+
+  bool connect(const node& n, string& error) {
+    fd_ = connect_to(n.first, n.second, error);
+    return fd_ >= 0;
+  }
+
+  // returns a frame writer for a message that gets sent by `flush`
+  frame_writer frame(msg_type type) {
+    return frame_writer{out_, type};
+  }
+
+  bool flush() {
+    size_t pos = 0;
+    while (pos < out_.size()) {
+      auto n = ::send(fd_, out_.data() + pos, out_.size() - pos, MSG_NOSIGNAL);
+      if (n <= 0)
+        return false;
+      pos += static_cast<size_t>(n);
+    }
+    out_.clear();
+    return true;
+  }
+
+  // waits up to `timeout_ms` (-1: forever) for the next frame and stores its
+  // body in `body`; returns false on timeout, error or disconnect
+  bool receive(string& body, int timeout_ms = -1) {
+    auto deadline = hrc::now() + std::chrono::milliseconds(timeout_ms);
+    for (;;) {
+      if (in_.size() >= 4) {
+        uint32_t len;
+        memcpy(&len, in_.data(), sizeof(len));
+        len = ntohl(len);
+        if (in_.size() - 4 >= len) {
+          body.assign(in_, 4, len);
+          in_.erase(0, 4 + len);
+          return true;
+        }
+      }
+      int wait = -1;
+      if (timeout_ms >= 0) {
+        using std::chrono::duration_cast;
+        using std::chrono::milliseconds;
+        auto left = duration_cast<milliseconds>(deadline - hrc::now()).count();
+        if (left <= 0)
+          return false;
+        wait = static_cast<int>(left);
+      }
+      pollfd pfd{fd_, POLLIN, 0};
+      if (poll(&pfd, 1, wait) <= 0)
+        return false;
+      char buf[4096];
+      auto n = ::recv(fd_, buf, sizeof(buf), 0);
+      if (n <= 0)
+        return false;
+      in_.append(buf, static_cast<size_t>(n));
+    }
+  }
+
+  // waits up to `timeout_ms` for the remote side to close the connection
+  bool wait_closed(int timeout_ms) {
+    pollfd pfd{fd_, POLLIN, 0};
+    char buf[4096];
+    while (poll(&pfd, 1, timeout_ms) > 0)
+      if (::recv(fd_, buf, sizeof(buf), 0) <= 0)
+        return true;
+    return false;
+  }
+
+private:
+  int fd_;
+  string in_;
+  string out_;
+};
+
+struct config {
+  string mode;
+  int port = 0;
+  int num_pings = 0;
+  int nodes = 4;
+  int payload = 0;
+  int ping_actors = 1;
+  string wire_out;
+  vector<string> remainder;
+  bool help = false;
+};
+
+void usage() {
+  cout << "Running in server mode:"                                    << endl
+       << "  --mode=server  "                                          << endl
+       << "  --port=NUM       listens at port NUM"                     << endl
+       << endl
+       << endl
+       << "Running the benchmark:"                                     << endl
+       << "  --mode=benchmark run the benchmark, connect to any number"<< endl
+       << "                   of given servers, use HOST:PORT syntax"  << endl
+       << "  --num-pings=NUM  run benchmark with NUM messages per pair"<< endl
+       << "  --payload=BYTES  send BYTES of payload per ping and pong" << endl
+       << "  --ping-actors=NUM"                                        << endl
+       << "                   run NUM concurrent pingers per pair"     << endl
+       << "  --wire-out=FILE  append wire statistics as CSV to FILE"   << endl
+       << endl
+       << "  example: --mode=benchmark --num-pings=100 "
+                                        "192.168.9.1:1234 "
+                                        "192.168.9.2:1234"             << endl
+       << endl
+       << endl
+       << "Shutdown servers:"                                          << endl
+       << "  --mode=shutdown  shuts down any number of given servers"  << endl
+       << endl
+       << endl
+       << "Running the benchmark on a local cluster:"                  << endl
+       << "  --mode=cluster   forks servers on loopback, runs the"     << endl
+       << "                   benchmark and shuts the servers down"    << endl
+       << "  --nodes=NUM      number of server processes (default: 4)" << endl
+       << "  --num-pings=NUM  run benchmark with NUM messages per pair"<< endl
+       << endl
+       << endl
+       << "Miscellaneous:"                                             << endl
+       << "  -h, --help       print this text and exit"                << endl
+       << endl;
+}
+
+// returns false if an argument is invalid
+bool parse_args(int argc, char** argv, config& cfg) {
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "-h" || arg == "--help") {
+      cfg.help = true;
+      continue;
+    }
+    if (arg.compare(0, 2, "--") != 0) {
+      cfg.remainder.push_back(arg);
+      continue;
+    }
+    auto sep = arg.find('=');
+    auto key = arg.substr(2, sep == string::npos ? sep : sep - 2);
+    auto value = sep == string::npos ? string{} : arg.substr(sep + 1);
+    if (key == "mode")
+      cfg.mode = value;
+    else if (key == "port")
+      cfg.port = atoi(value.c_str());
+    else if (key == "num-pings")
+      cfg.num_pings = atoi(value.c_str());
+    else if (key == "nodes")
+      cfg.nodes = atoi(value.c_str());
+    else if (key == "payload")
+      cfg.payload = atoi(value.c_str());
+    else if (key == "ping-actors")
+      cfg.ping_actors = atoi(value.c_str());
+    else if (key == "wire-out")
+      cfg.wire_out = value;
+    else {
+      cerr << "unknown option: " << arg << endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// parses HOST:PORT arguments
+bool parse_nodes(const config& cfg, vector<node>& result) {
+  for (auto& arg : cfg.remainder) {
+    auto sep = arg.rfind(':');
+    int port = 0;
+    if (sep != string::npos)
+      port = atoi(arg.c_str() + sep + 1);
+    if (port <= 0 || port >= 65536) {
+      cerr << "expected HOST:PORT, got: " << arg << endl;
+      return false;
+    }
+    result.emplace_back(arg.substr(0, sep), static_cast<uint16_t>(port));
+  }
+  return true;
+}
+
+int server_mode(const config& cfg) {
+  if (cfg.port < 0 || cfg.port >= 65536) {
+    cerr << "illegal port: " << cfg.port << endl;
+    return 1;
+  }
+  auto port = static_cast<uint16_t>(cfg.port);
+  auto fd = listen_at("0.0.0.0", port);
+  if (fd < 0) {
+    perror("unable to listen");
+    return 1;
+  }
+  cout << "server published at port " << port << endl;
+  node_server{fd}.run();
+  return 0;
+}
+
+// returns the summed wire counters of all nodes
+bool query_wire_stats(vector<control_channel>& channels, wire_sample& result) {
+  for (auto& ch : channels)
+    ch.frame(stats_msg);
+  for (auto& ch : channels) {
+    string body;
+    if (!ch.flush() || !ch.receive(body))
+      return false;
+    frame_reader rd{body.data(), body.size()};
+    rd.get<uint8_t>();
+    result.bytes_out += rd.get<uint64_t>();
+    result.bytes_in += rd.get<uint64_t>();
+    result.segments_out += rd.get<uint64_t>();
+    result.send_calls += rd.get<uint64_t>();
+    result.recv_calls += rd.get<uint64_t>();
+    if (!rd.ok)
+      return false;
+  }
+  return true;
+}
+
+// pings between all pairs of `nodes` and prints throughput, latency and how
+// efficiently the nodes use the wire
+int run_benchmark(const vector<node>& nodes, const config& cfg) {
+  auto num_pings = cfg.num_pings;
+  if (num_pings <= 0) {
+    cerr << "no non-zero, non-negative init value given" << endl;
+    return 1;
+  }
+  if (nodes.size() < 2) {
+    cerr << "less than two nodes given" << endl;
+    return 1;
+  }
+  if (cfg.payload < 0 || cfg.ping_actors <= 0) {
+    cerr << "invalid payload size or number of ping actors" << endl;
+    return 1;
+  }
+  vector<control_channel> channels(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    string error;
+    if (!channels[i].connect(nodes[i], error)) {
+      cerr << error << endl;
+      return 1;
+    }
+  }
+  auto purge_all = [&] {
+    for (auto& ch : channels) {
+      ch.frame(purge_msg);
+      ch.flush();
+    }
+  };
+  // setup phase: tell server nodes to connect to each other
+  for (size_t i = 0; i < nodes.size(); ++i)
+    for (size_t j = 0; j < nodes.size(); ++j)
+      if (i != j)
+        channels[i].frame(add_pong_msg).put(nodes[j].first)
+                                       .put(nodes[j].second);
+  bool setup_failed = false;
+  for (size_t i = 0; i < nodes.size() && !setup_failed; ++i) {
+    channels[i].flush();
+    for (size_t j = 1; j < nodes.size() && !setup_failed; ++j) {
+      string body;
+      if (!channels[i].receive(body, 10000)) {
+        cerr << "remote didn't answer within 10sec." << endl;
+        setup_failed = true;
+      } else if (body.empty() || static_cast<uint8_t>(body[0]) != ok_msg) {
+        frame_reader rd{body.data() + 1, body.size() - 1};
+        cerr << "error: " << rd.get_string() << endl;
+        setup_failed = true;
+      }
+    }
+  }
+  auto num_pairs = nodes.size() * (nodes.size() - 1);
+  // the difference to the counters after the run excludes connection setup
+  wire_sample w0;
+  if (setup_failed || !query_wire_stats(channels, w0)) {
+    purge_all();
+    return 1;
+  }
+  // kickoff: every server pings every other server concurrently
+  auto t0 = hrc::now();
+  for (size_t i = 0; i < channels.size(); ++i) {
+    channels[i].frame(kickoff_msg).put(static_cast<uint32_t>(num_pings))
+                                  .put(static_cast<uint32_t>(i))
+                                  .put(static_cast<uint32_t>(cfg.payload))
+                                  .put(static_cast<uint32_t>(cfg.ping_actors));
+    channels[i].flush();
+  }
+  // pings sent, sum of their RTTs and the time until the last pinger
+  // finished per node
+  struct node_stats {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t elapsed = 0;
+  };
+  vector<node_stats> per_node(nodes.size());
+  uint64_t total_count = 0;
+  uint64_t total_sum = 0;
+  uint64_t max_rtt = 0;
+  uint64_t worst_p99 = 0;
+  vector<uint64_t> medians;
+  // each node reports once per pinger, i.e., per peer and ping actor
+  auto pingers_per_node = (nodes.size() - 1)
+                          * static_cast<size_t>(cfg.ping_actors);
+  for (auto& ch : channels) {
+    for (size_t i = 0; i < pingers_per_node; ++i) {
+      string body;
+      if (!ch.receive(body)) {
+        cerr << "lost connection to a node" << endl;
+        return 1;
+      }
+      frame_reader rd{body.data() + 1, body.size() - 1};
+      auto node_id = rd.get<uint32_t>();
+      auto count = rd.get<uint64_t>();
+      auto sum = rd.get<uint64_t>();
+      auto p50 = rd.get<uint64_t>();
+      auto p99 = rd.get<uint64_t>();
+      auto max = rd.get<uint64_t>();
+      auto elapsed = rd.get<uint64_t>();
+      if (!rd.ok || node_id >= per_node.size()) {
+        cerr << "malformed done message" << endl;
+        return 1;
+      }
+      auto& ns = per_node[node_id];
+      ns.count += count;
+      ns.sum += sum;
+      ns.elapsed = std::max(ns.elapsed, elapsed);
+      total_count += count;
+      total_sum += sum;
+      medians.push_back(p50);
+      worst_p99 = std::max(worst_p99, p99);
+      max_rtt = std::max(max_rtt, max);
+    }
+  }
+  auto t1 = hrc::now();
+  wire_sample w1;
+  if (!query_wire_stats(channels, w1)) {
+    cerr << "unable to query wire statistics" << endl;
+    return 1;
+  }
+  purge_all();
+  auto seconds = std::chrono::duration<double>(t1 - t0).count();
+  std::sort(medians.begin(), medians.end());
+  auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+  cout << "nodes: " << nodes.size() << ", pairs: " << num_pairs
+       << ", ping actors per pair: " << cfg.ping_actors
+       << ", payload: " << cfg.payload << " bytes"
+       << ", pings: " << total_count << endl
+       << "pings/s: " << static_cast<double>(total_count) / seconds << endl
+       << "rtt (us): mean "
+       << us(total_sum) / static_cast<double>(total_count)
+       << ", median p50 " << us(medians[medians.size() / 2])
+       << ", worst p99 " << us(worst_p99)
+       << ", max " << us(max_rtt) << endl;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    auto& ns = per_node[i];
+    cout << "node " << i << " (" << nodes[i].first << ":" << nodes[i].second
+         << "): pings " << ns.count << ", pings/s "
+         << static_cast<double>(ns.count) / (us(ns.elapsed) / 1e6)
+         << ", mean rtt (us) "
+         << us(ns.sum) / static_cast<double>(ns.count) << endl;
+  }
+  // same accounting as the CAF version: bytes and segments are counted at
+  // the sending socket, the few control messages are included
+  auto messages = static_cast<double>(2 * total_count);
+  auto per_msg = [&](uint64_t before, uint64_t after) {
+    return static_cast<double>(after - before) / messages;
+  };
+  // IPv4 + TCP header with timestamp option, no link layer
+  constexpr double tcp_ip_header_size = 52;
+  auto stream_bytes = per_msg(w0.bytes_out, w1.bytes_out);
+  auto segments = per_msg(w0.segments_out, w1.segments_out);
+  auto sends = per_msg(w0.send_calls, w1.send_calls);
+  auto recvs = per_msg(w0.recv_calls, w1.recv_calls);
+  auto batching = sends > 0 ? 1.0 / sends : 0.0;
+  cout << "wire per message: " << stream_bytes << " stream bytes, "
+       << segments << " segments, "
+       << stream_bytes + segments * tcp_ip_header_size
+       << " bytes incl. TCP/IP headers" << endl
+       << "syscalls per message: " << sends << " send, " << recvs
+       << " recv, batching: " << batching << " messages per send" << endl;
+  if (!cfg.wire_out.empty()) {
+    ifstream existing{cfg.wire_out};
+    auto empty = !existing || existing.peek() == ifstream::traits_type::eof();
+    ofstream out{cfg.wire_out, std::ios::app};
+    if (empty)
+      out << "payload,ping_actors,pings_per_s,mean_rtt_us,stream_bytes_per_msg,"
+             "segments_per_msg,wire_bytes_per_msg,sends_per_msg,recvs_per_msg,"
+             "msgs_per_send,precise" << endl;
+    out << cfg.payload << "," << cfg.ping_actors << ","
+        << static_cast<double>(total_count) / seconds << ","
+        << us(total_sum) / static_cast<double>(total_count) << ","
+        << stream_bytes << "," << segments << ","
+        << stream_bytes + segments * tcp_ip_header_size << "," << sends << ","
+        << recvs << "," << batching << ",1" << endl;
+  }
+  return 0;
+}
+
+int client_mode(const config& cfg) {
+  vector<node> nodes;
+  if (!parse_nodes(cfg, nodes))
+    return 1;
+  return run_benchmark(nodes, cfg);
+}
+
+int shutdown_nodes(const vector<node>& nodes) {
+  int result = 0;
+  for (auto& n : nodes) {
+    control_channel ch;
+    string error;
+    if (!ch.connect(n, error)) {
+      cerr << "couldn't shutdown " << n.first << ":" << n.second
+           << "; reason: " << error << endl;
+      result = 1;
+      continue;
+    }
+    ch.frame(shutdown_msg);
+    // the node closes all connections when leaving its event loop
+    if (!ch.flush() || !ch.wait_closed(10000)) {
+      cerr << n.first << ":" << n.second << " didn't shut down "
+           << "within 10s" << endl;
+      result = 1;
+    }
+  }
+  return result;
+}
+
+int shutdown_mode(const config& cfg) {
+  vector<node> nodes;
+  if (!parse_nodes(cfg, nodes))
+    return 1;
+  return shutdown_nodes(nodes);
+}
+
+// returns the i-th of n disjoint, contiguous chunks of `cpus` or a single
+// CPU (round-robin) if there are more nodes than CPUs
+vector<int> node_cpus(const vector<int>& cpus, size_t i, size_t n) {
+  if (cpus.empty())
+    return {};
+  if (n >= cpus.size())
+    return {cpus[i % cpus.size()]};
+  return {cpus.begin() + static_cast<ptrdiff_t>(i * cpus.size() / n),
+          cpus.begin() + static_cast<ptrdiff_t>((i + 1) * cpus.size() / n)};
+}
+
+// runs in a forked child: starts a node pinned to `cpus` on loopback, writes
+// its port to `fd` and returns after the node got shut down
+int cluster_node(const vector<int>& cpus, int fd) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus)
+    CPU_SET(cpu, &set);
+  if (!cpus.empty() && sched_setaffinity(0, sizeof(set), &set) != 0)
+    perror("sched_setaffinity");
+  uint16_t port = 0;
+  auto listen_fd = listen_at("127.0.0.1", port);
+  if (listen_fd < 0) {
+    perror("unable to listen");
+    return 1;
+  }
+  if (write(fd, &port, sizeof(port)) != sizeof(port)) {
+    close(listen_fd);
+    return 1;
+  }
+  close(fd);
+  node_server{listen_fd}.run();
+  return 0;
+}
+
+// forks `cfg.nodes` servers, runs the benchmark against them and shuts them
+// down again
+int cluster_mode(const config& cfg) {
+  if (cfg.nodes < 2) {
+    cerr << "less than two nodes given" << endl;
+    return 1;
+  }
+  auto num_nodes = static_cast<size_t>(cfg.nodes);
+  auto cpus = topology::local().cpu_ids();
+  vector<pid_t> children;
+  vector<node> nodes;
+  auto wait_for_children = [&]() -> int {
+    int result = 0;
+    for (auto pid : children) {
+      int status = 0;
+      if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)
+          || WEXITSTATUS(status) != 0) {
+        cerr << "node with PID " << pid << " did not exit cleanly" << endl;
+        result = 1;
+      }
+    }
+    return result;
+  };
+  for (size_t i = 0; i < num_nodes; ++i) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+      perror("pipe");
+      abort();
+    }
+    auto pin = node_cpus(cpus, i, num_nodes);
+    // flush before forking to not print buffered output twice
+    cout.flush();
+    auto pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      abort();
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      _exit(cluster_node(pin, fds[1]));
+    }
+    close(fds[1]);
+    children.push_back(pid);
+    uint16_t port = 0;
+    auto n = read(fds[0], &port, sizeof(port));
+    close(fds[0]);
+    if (n != sizeof(port)) {
+      cerr << "node " << i << " failed to start" << endl;
+      for (auto child : children)
+        kill(child, SIGTERM);
+      wait_for_children();
+      return 1;
+    }
+    cout << "node " << i << ": 127.0.0.1:" << port << ", CPUs";
+    for (auto cpu : pin)
+      cout << " " << cpu;
+    cout << endl;
+    nodes.emplace_back("127.0.0.1", port);
+  }
+  auto result = run_benchmark(nodes, cfg);
+  if (shutdown_nodes(nodes) != 0)
+    result = 1;
+  if (wait_for_children() != 0)
+    result = 1;
+  return result;
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char** argv) {
+  config cfg;
+  if (!parse_args(argc, argv, cfg))
+    return 1;
+  if (cfg.help) {
+    usage();
+    return 0;
+  }
+  if (cfg.mode == "server")
+    return server_mode(cfg);
+  if (cfg.mode == "benchmark")
+    return client_mode(cfg);
+  if (cfg.mode == "shutdown")
+    return shutdown_mode(cfg);
+  if (cfg.mode == "cluster")
+    return cluster_mode(cfg);
+  usage();
+  return cfg.mode.empty() ? 0 : 1;
+}
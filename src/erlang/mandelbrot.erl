@@ -8,17 +8,26 @@
 start(X) ->
     [H0|_] = X,
     N = list_to_integer(atom_to_list(H0)),
+    Self = self(),
     %% Spawn one process per row
-    Row = fun(Y)-> spawn(fun()-> row(0, ?SI+Y*2/N, N, 0, [], 7) end) end,
-    Pids = lists:map(Row, lists:seq(0,N-1)),
-    %Pass token around to make sure printouts are in the right order
-    hd(Pids) ! tl(Pids) ++ [ self() ],
-    receive _Token -> halt(0) end.
-
-%Iterate over a row, collect bits, bytes and finally print the row
-row(X, _, N, _, _, _) when X =:= N-1 ->
-    receive Pids ->
-        hd(Pids) ! tl(Pids)
+    Row = fun(Y)-> spawn(fun()-> Self ! {Y, row(0, ?SI+Y*2/N, N, 0, [], 7)} end) end,
+    lists:foreach(Row, lists:seq(0,N-1)),
+    %Same checksum as all other implementations: Adler-32 of the PBM pixel data
+    io:format("checksum: ~b~n", [erlang:adler32(collect(N, []))]),
+    halt(0).
+
+%Receive all rows and return them in order
+collect(0, Rows) ->
+    [Bin || {_, Bin} <- lists:keysort(1, Rows)];
+
+collect(K, Rows) ->
+    receive {Y, Bin} -> collect(K-1, [{Y, Bin} | Rows]) end.
+
+%Iterate over a row, collect bits and bytes, pad the last byte with zeros
+row(X, _, N, Bits, Bytes, BitC) when X =:= N ->
+    case BitC of
+    7 -> list_to_binary(lists:reverse(Bytes));
+    _ -> list_to_binary(lists:reverse([Bits bsl (BitC + 1) | Bytes]))
     end;
 
 row(X, Y2, N, Bits, Bytes, 0) ->
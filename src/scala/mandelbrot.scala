@@ -88,15 +88,10 @@ object mandelbrot {
         system.actorOf(Props[Worker]) ! Row(i)
       }
       global_latch.await
-      // main thread prints rows as they finish
-      //println("P4\n" + size + " " + size)
-      //val w = new BufferedOutputStream(System.out)
-      //var y = 0
-      //while (y < size) {
-      // w.write(bitmap, y * bytesPerRow, bytesPerRow)
-      //  y += 1
-      //}
-      //w.close
+      // same checksum as all other implementations
+      val checksum = new java.util.zip.Adler32
+      checksum.update(bitmap, 0, bitmap.length)
+      println("checksum: " + checksum.getValue)
       system.shutdown
       System.exit(0)
     }
@@ -1,14 +1,27 @@
 #include <pwd.h>
+#include <poll.h>
+#include <errno.h>
+#include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
+#include <sched.h>
 #include <sys/wait.h>
 #include <sys/types.h>
+#include <sys/utsname.h>
 
+#include <map>
+#include <set>
+#include <cctype>
+#include <atomic>
 #include <chrono>
+#include <thread>
+#include <vector>
 #include <fstream>
+#include <sstream>
 #include <iostream>
+#include <algorithm>
 
 #include "caf/all.hpp"
 
@@ -19,6 +32,10 @@
 # include <mach/kern_return.h>
 #endif
 
+#ifdef __linux__
+# include "sampling_profiler.hpp"
+#endif
+
 using namespace std;
 using namespace caf;
 
@@ -120,6 +137,474 @@ void memrecord(blocking_actor* self, int poll_interval, std::ostream* out_ptr) {
   );
 }
 
+// cumulative scheduling statistics of a single thread
+struct thread_sample {
+  string name;
+  unsigned long long utime = 0;       // in clock ticks
+  unsigned long long stime = 0;       // in clock ticks
+  unsigned long long run_ns = 0;      // time on a CPU
+  unsigned long long wait_ns = 0;     // time runnable but waiting for a CPU
+  unsigned long long voluntary = 0;   // blocked, e.g., waiting for work
+  unsigned long long involuntary = 0; // preempted
+};
+
+// reads stat, schedstat and status of /proc/<pid>/task/<tid>
+bool read_thread_sample(const string& dir, thread_sample& out) {
+  ifstream stat{dir + "/stat"};
+  string line;
+  if (!getline(stat, line))
+    return false;
+  // the name may contain spaces and parentheses, fields follow the last ')'
+  auto first = line.find('(');
+  auto last = line.rfind(')');
+  if (first == string::npos || last == string::npos || last < first)
+    return false;
+  out.name = line.substr(first + 1, last - first - 1);
+  replace(out.name.begin(), out.name.end(), ',', ' ');
+  istringstream fields{line.substr(last + 2)};
+  string field;
+  // utime and stime are fields 14 and 15, i.e., 12 and 13 after the name
+  for (int i = 3; i <= 15 && fields >> field; ++i) {
+    if (i == 14)
+      out.utime = strtoull(field.c_str(), nullptr, 10);
+    else if (i == 15)
+      out.stime = strtoull(field.c_str(), nullptr, 10);
+  }
+  ifstream schedstat{dir + "/schedstat"};
+  schedstat >> out.run_ns >> out.wait_ns;
+  ifstream status{dir + "/status"};
+  while (getline(status, line)) {
+    if (line.compare(0, 24, "voluntary_ctxt_switches:") == 0)
+      out.voluntary = strtoull(line.c_str() + 24, nullptr, 10);
+    else if (line.compare(0, 27, "nonvoluntary_ctxt_switches:") == 0)
+      out.involuntary = strtoull(line.c_str() + 27, nullptr, 10);
+  }
+  return true;
+}
+
+// writes one CSV row per thread of the child and poll interval with the
+// CPU time, run-queue wait and context switches since the previous row
+void threadrecord(blocking_actor* self, int poll_interval,
+                  std::ostream* out_ptr) {
+  auto& out = *out_ptr;
+  pid_t child;
+  self->receive(
+    [&](go_atom, pid_t child_pid) {
+      child = child_pid;
+    }
+  );
+  auto task_dir = "/proc/" + std::to_string(child) + "/task";
+  auto ms_per_tick = 1000. / static_cast<double>(sysconf(_SC_CLK_TCK));
+  map<pid_t, thread_sample> last;
+  self->send(self, poll_atom::value);
+  bool running = true;
+  self->receive_while(running)(
+    [&](poll_atom) {
+      self->delayed_send(self, chrono::milliseconds(poll_interval),
+                         poll_atom::value);
+      auto now = chrono::duration_cast<chrono::milliseconds>(
+                   chrono::system_clock::now() - s_start).count();
+      auto dir = opendir(task_dir.c_str());
+      if (dir == nullptr)
+        return;
+      while (auto entry = readdir(dir)) {
+        if (entry->d_name[0] == '.')
+          continue;
+        auto tid = static_cast<pid_t>(atoi(entry->d_name));
+        thread_sample x;
+        if (!read_thread_sample(task_dir + "/" + entry->d_name, x))
+          continue;
+        auto& prev = last[tid];
+        out << now << "," << tid << "," << x.name << ","
+            << (x.utime - prev.utime) * ms_per_tick << ","
+            << (x.stime - prev.stime) * ms_per_tick << ","
+            << (x.run_ns - prev.run_ns) / 1e6 << ","
+            << (x.wait_ns - prev.wait_ns) / 1e6 << ","
+            << (x.voluntary - prev.voluntary) << ","
+            << (x.involuntary - prev.involuntary) << "\n";
+        prev = std::move(x);
+      }
+      closedir(dir);
+    },
+    [&](const exit_msg& msg) {
+      if (msg.reason) {
+       self->fail_state(std::move(msg.reason));
+       running = false;
+      }
+    }
+  );
+}
+
+// system-wide NUMA allocation counters, summed over all nodes
+struct numa_counters {
+  unsigned long long numa_hit = 0;   // allocated on the intended node
+  unsigned long long numa_miss = 0;  // intended elsewhere, allocated here
+  unsigned long long local_node = 0; // allocated on the node of the CPU
+  unsigned long long other_node = 0; // allocated on another node
+};
+
+// reads /sys/devices/system/node/node*/numastat, returns false if the kernel
+// has no NUMA support
+bool read_numastat(numa_counters& out) {
+  out = numa_counters{};
+  const string sys_node = "/sys/devices/system/node/";
+  auto dir = opendir(sys_node.c_str());
+  if (dir == nullptr)
+    return false;
+  bool found = false;
+  while (auto entry = readdir(dir)) {
+    string name = entry->d_name;
+    if (name.compare(0, 4, "node") != 0 || name.size() == 4)
+      continue;
+    ifstream in{sys_node + name + "/numastat"};
+    string key;
+    unsigned long long value;
+    while (in >> key >> value) {
+      found = true;
+      if (key == "numa_hit")
+        out.numa_hit += value;
+      else if (key == "numa_miss")
+        out.numa_miss += value;
+      else if (key == "local_node")
+        out.local_node += value;
+      else if (key == "other_node")
+        out.other_node += value;
+    }
+  }
+  closedir(dir);
+  return found;
+}
+
+// resident memory of a process in kB per NUMA node, parsed from the
+// "N<node>=<pages>" fields of /proc/<pid>/numa_maps
+map<int, unsigned long long> read_numa_maps(pid_t pid) {
+  map<int, unsigned long long> result;
+  ifstream in{"/proc/" + std::to_string(pid) + "/numa_maps"};
+  string line;
+  while (getline(in, line)) {
+    istringstream fields{line};
+    string field;
+    unsigned long long page_kb = 4;
+    map<int, unsigned long long> pages;
+    while (fields >> field) {
+      if (field.size() > 1 && field[0] == 'N' && isdigit(field[1])) {
+        auto eq = field.find('=');
+        if (eq != string::npos)
+          pages[atoi(field.c_str() + 1)] += strtoull(field.c_str() + eq + 1,
+                                                     nullptr, 10);
+      } else if (field.compare(0, 17, "kernelpagesize_kB") == 0) {
+        page_kb = strtoull(field.c_str() + 18, nullptr, 10);
+      }
+    }
+    for (auto& kvp : pages)
+      result[kvp.first] += kvp.second * page_kb;
+  }
+  return result;
+}
+
+// returns the target of /proc/<pid>/exe or an empty string on error
+string read_exe(const string& pid) {
+  char buf[4096];
+  auto n = readlink(("/proc/" + pid + "/exe").c_str(), buf, sizeof(buf));
+  return n > 0 ? string(buf, static_cast<size_t>(n)) : string{};
+}
+
+// keeps the last per-node snapshot of the memory of the child, since
+// numa_maps disappears together with the process; polls every millisecond
+// until the child has called exec, because snapshots taken before that
+// show the forked image of caf_run_bench
+void numarecord(blocking_actor* self, int poll_interval,
+                map<int, unsigned long long>* last) {
+  pid_t child;
+  self->receive(
+    [&](go_atom, pid_t child_pid) {
+      child = child_pid;
+    }
+  );
+  auto self_exe = read_exe("self");
+  bool exec_done = false;
+  self->send(self, poll_atom::value);
+  bool running = true;
+  self->receive_while(running)(
+    [&](poll_atom) {
+      if (!exec_done) {
+        auto child_exe = read_exe(std::to_string(child));
+        exec_done = !child_exe.empty() && child_exe != self_exe;
+      }
+      auto interval = exec_done ? poll_interval : 1;
+      self->delayed_send(self, chrono::milliseconds(interval),
+                         poll_atom::value);
+      if (!exec_done)
+        return;
+      auto snapshot = read_numa_maps(child);
+      if (!snapshot.empty())
+        *last = std::move(snapshot);
+    },
+    [&](const exit_msg& msg) {
+      if (msg.reason) {
+       self->fail_state(std::move(msg.reason));
+       running = false;
+      }
+    }
+  );
+}
+
+// energy counter of one RAPL domain, e.g., "package-0" or "package-0/dram"
+struct rapl_domain {
+  string name;
+  string counter_file;         // energy_uj
+  unsigned long long range_uj; // counter wraps around after this value
+  unsigned long long last_uj;
+  double joules;
+};
+
+unsigned long long read_ull(const string& path) {
+  ifstream in{path};
+  unsigned long long result = 0;
+  in >> result;
+  return result;
+}
+
+// finds all readable domains under /sys/class/powercap, returns an empty
+// list if the machine has no RAPL interface (or we lack permissions)
+vector<rapl_domain> open_rapl_domains() {
+  vector<rapl_domain> result;
+  const string powercap = "/sys/class/powercap/";
+  auto dir = opendir(powercap.c_str());
+  if (dir == nullptr)
+    return result;
+  vector<string> zones;
+  while (auto entry = readdir(dir)) {
+    // zones are "intel-rapl:<package>" and "intel-rapl:<package>:<sub>",
+    // plain "intel-rapl" is the control type
+    string name = entry->d_name;
+    if (name.compare(0, 11, "intel-rapl:") == 0)
+      zones.push_back(name);
+  }
+  closedir(dir);
+  sort(zones.begin(), zones.end());
+  for (auto& zone : zones) {
+    auto path = powercap + zone + "/";
+    ifstream name_file{path + "name"};
+    ifstream counter{path + "energy_uj"};
+    string name;
+    unsigned long long value;
+    if (!(name_file >> name) || !(counter >> value))
+      continue;
+    // prefix subzones such as "dram" with the name of their package
+    auto sep = zone.find(':', 11);
+    if (sep != string::npos)
+      for (auto& parent : result)
+        if (parent.counter_file == powercap + zone.substr(0, sep)
+                                   + "/energy_uj")
+          name = parent.name + "/" + name;
+    result.push_back(rapl_domain{name, path + "energy_uj",
+                                 read_ull(path + "max_energy_range_uj"),
+                                 value, 0});
+  }
+  return result;
+}
+
+// adds the energy consumed since the last call to each domain; must run at
+// least once per wraparound period (minutes at full load)
+void update_rapl_domains(vector<rapl_domain>& domains) {
+  for (auto& d : domains) {
+    auto now = read_ull(d.counter_file);
+    auto delta = now >= d.last_uj ? now - d.last_uj
+                                  : d.range_uj - d.last_uj + now;
+    d.joules += static_cast<double>(delta) / 1e6;
+    d.last_uj = now;
+  }
+}
+
+void reset_rapl_domains(vector<rapl_domain>& domains) {
+  for (auto& d : domains) {
+    d.last_uj = read_ull(d.counter_file);
+    d.joules = 0;
+  }
+}
+
+// samples the RAPL counters periodically to catch wraparounds during long
+// runs, the last update happens after the child exited
+void energyrecord(blocking_actor* self, int poll_interval,
+                  vector<rapl_domain>* domains) {
+  self->receive(
+    [&](go_atom, pid_t) {
+      // nop
+    }
+  );
+  self->send(self, poll_atom::value);
+  bool running = true;
+  self->receive_while(running)(
+    [&](poll_atom) {
+      self->delayed_send(self, chrono::milliseconds(poll_interval),
+                         poll_atom::value);
+      update_rapl_domains(*domains);
+    },
+    [&](const exit_msg& msg) {
+      if (msg.reason) {
+       self->fail_state(std::move(msg.reason));
+       running = false;
+      }
+    }
+  );
+}
+
+#ifndef CAF_BENCH_COMPILER
+# define CAF_BENCH_COMPILER "unknown"
+#endif
+#ifndef CAF_BENCH_CXX_FLAGS
+# define CAF_BENCH_CXX_FLAGS "unknown"
+#endif
+
+string read_first_line(const string& path) {
+  ifstream in{path};
+  string result;
+  getline(in, result);
+  return result.empty() ? "unknown" : result;
+}
+
+// FNV-1a over the whole file, enough to tell two builds apart
+string hash_file(const string& path) {
+  ifstream in{path, ios::binary};
+  if (!in)
+    return "unknown";
+  uint64_t result = 14695981039346656037ull;
+  char buf[4096];
+  while (in.read(buf, sizeof(buf)) || in.gcount() > 0) {
+    for (auto i = buf; i != buf + in.gcount(); ++i) {
+      result ^= static_cast<unsigned char>(*i);
+      result *= 1099511628211ull;
+    }
+  }
+  std::ostringstream oss;
+  oss << "fnv1a64:" << hex << result;
+  return oss.str();
+}
+
+// distinct values of a per-CPU cpufreq file, e.g., "performance,powersave"
+string cpufreq_setting(const string& file_name) {
+  set<string> values;
+  for (int cpu = 0;; ++cpu) {
+    ifstream in{"/sys/devices/system/cpu/cpu" + std::to_string(cpu)
+                + "/cpufreq/" + file_name};
+    string value;
+    if (!(in >> value)) {
+      if (access(("/sys/devices/system/cpu/cpu" + std::to_string(cpu))
+                   .c_str(), F_OK) != 0)
+        break;
+      continue;
+    }
+    values.insert(value);
+  }
+  string result;
+  for (auto& value : values)
+    result += (result.empty() ? "" : ",") + value;
+  return result.empty() ? "unknown" : result;
+}
+
+// collects the conditions a benchmark runs under as "key: value" lines,
+// keys are documented in machine_fingerprint_keys of to_csv
+string fingerprint(const string& bench, const string& profile) {
+  std::ostringstream out;
+  string model = "unknown";
+  ifstream cpuinfo{"/proc/cpuinfo"};
+  string line;
+  while (getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") == 0
+        || line.compare(0, 9, "Processor") == 0) {
+      auto pos = line.find(':');
+      if (pos != string::npos && pos + 2 <= line.size()) {
+        model = line.substr(pos + 2);
+        break;
+      }
+    }
+  }
+  out << "cpu_model: " << model << endl
+      << "governor: " << cpufreq_setting("scaling_governor") << endl
+      << "max_freq_khz: " << cpufreq_setting("scaling_max_freq") << endl;
+  // intel_pstate reports no_turbo, acpi-cpufreq (and AMD) report boost
+  auto no_turbo = read_first_line("/sys/devices/system/cpu/intel_pstate/"
+                                  "no_turbo");
+  auto boost = read_first_line("/sys/devices/system/cpu/cpufreq/boost");
+  out << "turbo: " << (no_turbo == "0" || boost == "1"
+                       ? "on"
+                       : (no_turbo == "1" || boost == "0" ? "off"
+                                                          : "unknown"))
+      << endl;
+  // the active THP mode is the one in brackets, e.g., "always [madvise] never"
+  auto thp = read_first_line("/sys/kernel/mm/transparent_hugepage/enabled");
+  auto first = thp.find('[');
+  auto last = thp.find(']');
+  if (first != string::npos && last != string::npos && first < last)
+    thp = thp.substr(first + 1, last - first - 1);
+  out << "thp: " << thp << endl;
+  utsname uts;
+  out << "kernel: " << (uname(&uts) == 0 ? uts.release : "unknown") << endl
+      << "compiler: " << CAF_BENCH_COMPILER << endl
+      << "cxx_flags: " << CAF_BENCH_CXX_FLAGS << endl;
+#ifdef CAF_VERSION
+  out << "caf_version: " << CAF_VERSION << endl;
+#else
+  out << "caf_version: unknown" << endl;
+#endif
+  out << "binary: " << hash_file(bench) << endl;
+  // profiling slows down the benchmark, its results are not comparable
+  out << "profile: " << (profile.empty() ? "none" : profile) << endl;
+  string cores;
+#ifdef __linux__
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+      if (CPU_ISSET(cpu, &mask))
+        cores += (cores.empty() ? "" : ",") + std::to_string(cpu);
+#endif
+  out << "core_set: " << (cores.empty() ? "unknown" : cores) << endl;
+  ifstream loadavg{"/proc/loadavg"};
+  string load1, load5, load15;
+  if (loadavg >> load1 >> load5 >> load15)
+    out << "load_average: " << load1 << " " << load5 << " " << load15 << endl;
+  else
+    out << "load_average: unknown" << endl;
+  return out.str();
+}
+
+// forwards the output of the child to stdout and stores the value of the
+// last line starting with "checksum: " in `checksum`
+void scan_output(int fd, const std::atomic<bool>* child_done,
+                 string* checksum) {
+  static constexpr char prefix[] = "checksum: ";
+  static constexpr size_t prefix_size = sizeof(prefix) - 1;
+  string line;
+  char buf[4096];
+  pollfd pfd{fd, POLLIN, 0};
+  for (;;) {
+    // keep draining after the child exited, but do not wait for processes
+    // it left behind (e.g. epmd) that might keep the pipe open
+    auto done = child_done->load();
+    if (poll(&pfd, 1, done ? 0 : 100) <= 0) {
+      if (done)
+        break;
+      continue;
+    }
+    auto n = read(fd, buf, sizeof(buf));
+    if (n <= 0)
+      break;
+    cout.write(buf, n);
+    for (auto i = buf; i != buf + n; ++i) {
+      if (*i != '\n') {
+        line += *i;
+        continue;
+      }
+      if (line.compare(0, prefix_size, prefix) == 0)
+        *checksum = line.substr(prefix_size);
+      line.clear();
+    }
+  }
+  cout << flush;
+}
+
 namespace {
 
 class my_config : public actor_system_config {
@@ -127,9 +612,21 @@ public:
   int userid = 1000;
   int max_runtime = 3600;
   int mem_poll_interval = 50;
+  int thread_poll_interval = 100;
+  int numa_poll_interval = 500;
+  int energy_poll_interval = 1000;
+  uint64_t work_units = 0;
+  int profile_freq = 999;
+  string profile;
+  string profile_out_fname;
   string runtime_out_fname;
   string mem_out_fname;
+  string threads_out_fname;
+  string numa_local_out_fname;
+  string numa_other_out_fname;
+  string energy_out_fname;
   string bench;
+  string checksum;
 
   my_config() {
     opt_group{custom_options_, "global"}
@@ -139,7 +636,29 @@ public:
            "set memory poll intervall (in ms)")
       .add(runtime_out_fname, "runtime-out", "set runtime filename")
       .add(mem_out_fname, "mem-out", "set memory filename")
-      .add(bench, "bench", "set executable of the benchmark + plus args");
+      .add(threads_out_fname, "threads-out",
+           "set filename for the per-thread CPU timeline (CSV)")
+      .add(thread_poll_interval, "thread-poll-interval",
+           "set per-thread poll intervall (in ms)")
+      .add(numa_local_out_fname, "numa-local-out",
+           "set filename for node-local allocations")
+      .add(numa_other_out_fname, "numa-other-out",
+           "set filename for remote allocations")
+      .add(numa_poll_interval, "numa-poll-interval",
+           "set numa_maps poll intervall (in ms)")
+      .add(energy_out_fname, "energy-out", "set energy filename")
+      .add(energy_poll_interval, "energy-poll-interval",
+           "set RAPL poll intervall (in ms)")
+      .add(work_units, "work-units",
+           "report energy per unit, e.g., per message or spawned actor")
+      .add(profile, "profile",
+           "sample call stacks of the benchmark (fp|lbr|offcpu)")
+      .add(profile_out_fname, "profile-out",
+           "append folded stacks for flame graphs to this file")
+      .add(profile_freq, "profile-freq", "set sampling frequency (in Hz)")
+      .add(bench, "bench", "set executable of the benchmark + plus args")
+      .add(checksum, "checksum",
+           "reject the run unless the benchmark prints this checksum");
   }
 };
 
@@ -159,12 +678,77 @@ int caf_main(actor_system& system, const my_config& cfg) {
   init_fstream(cfg.runtime_out_fname, runtime_out);
   init_fstream(cfg.mem_out_fname, mem_out);
   std::ostringstream mem_out_buf;
+  std::fstream threads_out;
+  init_fstream(cfg.threads_out_fname, threads_out);
+  std::ostringstream threads_out_buf;
+  // NUMA counters are system-wide, so they only make sense on an otherwise
+  // idle machine; skip them on kernels without NUMA support
+  std::fstream numa_local_out;
+  std::fstream numa_other_out;
+  numa_counters numa_before;
+  map<int, unsigned long long> numa_pages;
+  bool numa_enabled = !cfg.numa_local_out_fname.empty()
+                      || !cfg.numa_other_out_fname.empty();
+  if (numa_enabled && !read_numastat(numa_before)) {
+    cerr << "no NUMA counters available, skip NUMA statistics" << endl;
+    numa_enabled = false;
+  }
+  if (numa_enabled) {
+    init_fstream(cfg.numa_local_out_fname, numa_local_out);
+    init_fstream(cfg.numa_other_out_fname, numa_other_out);
+  }
+  // RAPL energy counters are system-wide as well
+  std::fstream energy_out;
+  vector<rapl_domain> rapl;
+  if (!cfg.energy_out_fname.empty()) {
+    rapl = open_rapl_domains();
+    if (rapl.empty())
+      cerr << "no RAPL energy counters available, skip energy statistics"
+           << endl;
+    else
+      init_fstream(cfg.energy_out_fname, energy_out);
+  }
   // start background workers
   auto dog = system.spawn<detached>(watchdog, cfg.max_runtime);
   actor mem_rec;
   if (mem_out)
     mem_rec = system.spawn<detached>(memrecord, cfg.mem_poll_interval, &mem_out_buf);
+  actor thread_rec;
+  if (threads_out)
+    thread_rec = system.spawn<detached>(threadrecord,
+                                        cfg.thread_poll_interval,
+                                        &threads_out_buf);
+  actor numa_rec;
+  if (numa_enabled)
+    numa_rec = system.spawn<detached>(numarecord, cfg.numa_poll_interval,
+                                      &numa_pages);
+  actor energy_rec;
+  if (energy_out)
+    energy_rec = system.spawn<detached>(energyrecord,
+                                        cfg.energy_poll_interval, &rapl);
+  // capture the output of the child only when checking its result
+  int out_pipe[2] = {-1, -1};
+  if (!cfg.checksum.empty() && pipe(out_pipe) != 0) {
+    cerr << "pipe failed" << endl;
+    abort();
+  }
+  // the child waits for the profiler to attach before calling exec
+  int start_pipe[2] = {-1, -1};
+  if (!cfg.profile.empty()) {
+#ifdef __linux__
+    if (pipe(start_pipe) != 0) {
+      cerr << "pipe failed" << endl;
+      abort();
+    }
+#else
+    cerr << "profiling not supported on this platform" << endl;
+#endif
+  }
+  // record the environment before the child adds to the load
+  auto env_fingerprint = fingerprint(cfg.bench, cfg.profile);
   cout << "fork into " << cfg.bench << endl;
+  if (energy_out)
+    reset_rapl_domains(rapl);
   pid_t child_pid = fork();
   if (child_pid < 0) {
     cerr << "fork failed" << endl,
@@ -172,6 +756,11 @@ int caf_main(actor_system& system, const my_config& cfg) {
   }
   s_start = chrono::system_clock::now();
   if (child_pid == 0) {
+    if (out_pipe[1] >= 0) {
+      dup2(out_pipe[1], STDOUT_FILENO);
+      close(out_pipe[0]);
+      close(out_pipe[1]);
+    }
     if (setuid(static_cast<uid_t>(cfg.userid)) != 0) {
       cerr << "could not set userid to " << cfg.userid << endl;
       exit(1);
@@ -184,6 +773,14 @@ int caf_main(actor_system& system, const my_config& cfg) {
       cerr << "could net set HOME to " << pw->pw_dir << endl;
       exit(1);
     }
+    if (start_pipe[0] >= 0) {
+      char dummy;
+      close(start_pipe[1]);
+      // returns 0 once the parent closes its end
+      while (read(start_pipe[0], &dummy, 1) < 0 && errno == EINTR)
+        ; // retry
+      close(start_pipe[0]);
+    }
     vector<char*> arr;
     arr.emplace_back(const_cast<char*>(cfg.bench.c_str()));
     for (size_t i = 0; i < cfg.args_remainder.size(); ++i) {
@@ -196,24 +793,161 @@ int caf_main(actor_system& system, const my_config& cfg) {
     cerr << "execv failed" << endl;
     abort();
   }
+#ifdef __linux__
+  std::unique_ptr<sampling_profiler> prof;
+  std::unique_ptr<wchan_sampler> wchan;
+  std::thread prof_thread;
+  if (start_pipe[1] >= 0) {
+    close(start_pipe[0]);
+    prof.reset(new sampling_profiler(cfg.profile, cfg.profile_freq));
+    if (prof->attach(child_pid)) {
+      prof_thread = std::thread{[&] { prof->run(); }};
+    } else if (cfg.profile == "offcpu") {
+      cerr << "fall back to sampling wait channels" << endl;
+      prof.reset();
+      // walking /proc for each thread is far more expensive than sampling
+      wchan.reset(new wchan_sampler(child_pid,
+                                    std::min(cfg.profile_freq, 100)));
+      prof_thread = std::thread{[&] { wchan->run(); }};
+    } else {
+      cerr << "unable to profile " << cfg.bench << endl;
+      prof.reset();
+    }
+    close(start_pipe[1]);
+  }
+#endif
+  std::atomic<bool> child_done{false};
+  string checksum;
+  std::thread output_scanner;
+  if (out_pipe[0] >= 0) {
+    close(out_pipe[1]);
+    output_scanner = std::thread{scan_output, out_pipe[0], &child_done,
+                                 &checksum};
+  }
   auto msg = make_message(go_atom::value, child_pid);
   anon_send(dog, msg);
   if (mem_out) 
     anon_send(mem_rec, msg);
+  if (threads_out)
+    anon_send(thread_rec, msg);
+  if (numa_enabled)
+    anon_send(numa_rec, msg);
+  if (energy_out)
+    anon_send(energy_rec, msg);
   int child_exit_status = 0;
   wait(&child_exit_status);
   auto duration = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - s_start);
+  numa_counters numa_after;
+  if (numa_enabled)
+    read_numastat(numa_after);
+#ifdef __linux__
+  if (prof_thread.joinable()) {
+    if (prof)
+      prof->stop();
+    else
+      wchan->stop();
+    prof_thread.join();
+    if (prof)
+      cout << "profile: " << prof->samples() << " samples, " << prof->lost()
+           << " lost" << endl;
+    else
+      cout << "profile: " << wchan->samples() << " samples" << endl;
+  }
+#endif
+  if (output_scanner.joinable()) {
+    child_done = true;
+    output_scanner.join();
+    close(out_pipe[0]);
+  }
   anon_send_exit(dog, exit_reason::user_shutdown);
   if (mem_out) 
     anon_send_exit(mem_rec, exit_reason::user_shutdown);
+  if (threads_out)
+    anon_send_exit(thread_rec, exit_reason::user_shutdown);
+  if (numa_enabled)
+    anon_send_exit(numa_rec, exit_reason::user_shutdown);
+  if (energy_out)
+    anon_send_exit(energy_rec, exit_reason::user_shutdown);
   cout << "exit status: " << child_exit_status << endl;
   cout << "program did run for " << duration.count() << "ms" << endl;
   system.await_all_actors_done();
+  double package_joules = 0;
+  double dram_joules = 0;
+  if (energy_out) {
+    update_rapl_domains(rapl);
+    // the time between exit and this update is negligible compared to runs
+    for (auto& d : rapl) {
+      cout << "energy " << d.name << ": " << d.joules << " J" << endl;
+      if (d.name.compare(0, 8, "package-") != 0)
+        continue;
+      if (d.name.find('/') == string::npos)
+        package_joules += d.joules;
+      else if (d.name.compare(d.name.size() - 5, 5, "/dram") == 0)
+        dram_joules += d.joules;
+    }
+    if (cfg.work_units > 0)
+      cout << "energy per unit: "
+           << (package_joules + dram_joules) / cfg.work_units << " J" << endl;
+  }
+  if (child_exit_status == 0 && checksum != cfg.checksum) {
+    // a broken implementation might finish fast without doing the work
+    cerr << "checksum mismatch: expected " << cfg.checksum << ", found "
+         << (checksum.empty() ? "none" : checksum) << endl;
+    return 1;
+  }
   if (child_exit_status == 0) {
     if (runtime_out)
       runtime_out << duration.count() << endl;
+    // one block per run next to the runtime file, see to_csv
+    if (runtime_out) {
+      std::fstream fingerprint_out;
+      init_fstream(cfg.runtime_out_fname + ".fingerprint", fingerprint_out);
+      fingerprint_out << env_fingerprint << endl;
+    }
     if (mem_out)
       mem_out << mem_out_buf.str() << flush;
+    if (threads_out)
+      threads_out << "time_ms,tid,name,user_ms,system_ms,run_ms,"
+                     "runq_wait_ms,voluntary_cs,involuntary_cs\n"
+                  << threads_out_buf.str() << flush;
+    if (numa_enabled) {
+      // resident kB of the child on the node holding most of its memory
+      // ("home") vs. all other nodes, as last seen before it exited
+      unsigned long long home_kb = 0;
+      unsigned long long total_kb = 0;
+      for (auto& kvp : numa_pages) {
+        home_kb = max(home_kb, kvp.second);
+        total_kb += kvp.second;
+      }
+      // columns: allocated pages, pages hit/missed the intended node, kB
+      if (numa_local_out)
+        numa_local_out << (numa_after.local_node - numa_before.local_node)
+                       << " " << (numa_after.numa_hit - numa_before.numa_hit)
+                       << " " << home_kb << endl;
+      if (numa_other_out)
+        numa_other_out << (numa_after.other_node - numa_before.other_node)
+                       << " " << (numa_after.numa_miss - numa_before.numa_miss)
+                       << " " << (total_kb - home_kb) << endl;
+    }
+    // columns: package J, DRAM J, (package + DRAM) J per work unit or 0
+    if (energy_out)
+      energy_out << package_joules << " " << dram_joules << " "
+                 << (cfg.work_units > 0
+                     ? (package_joules + dram_joules) / cfg.work_units
+                     : 0.)
+                 << endl;
+#ifdef __linux__
+    // one file per configuration, repetitions simply add up
+    if (!cfg.profile_out_fname.empty()
+        && ((prof && prof->samples() > 0) || (wchan && wchan->samples() > 0))) {
+      std::fstream profile_out;
+      init_fstream(cfg.profile_out_fname, profile_out);
+      if (prof)
+        prof->write_folded(profile_out);
+      else
+        wchan->write_folded(profile_out);
+    }
+#endif
   }
   return child_exit_status;
 }
@@ -0,0 +1,783 @@
+#ifndef SAMPLING_PROFILER_HPP
+#define SAMPLING_PROFILER_HPP
+
+#include <elf.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cxxabi.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <map>
+#include <tuple>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <iostream>
+#include <algorithm>
+
+// Samples the call stacks of a child process and all threads and processes
+// it starts via perf_event_open, then symbolizes them from the ELF symbol
+// tables of the mapped files and writes folded stacks for flame graphs:
+//
+//   sampling_profiler prof{"fp", 999};
+//   prof.attach(child_pid);  // before the child calls exec
+//   std::thread t{[&] { prof.run(); }};
+//   ...                      // let the child exec and wait for it
+//   prof.stop();
+//   t.join();
+//   prof.write_folded(out);
+//
+// Modes are "fp" (frame pointer callchains, needs -fno-omit-frame-pointer
+// for useful stacks) and "lbr" (last branch record call stacks, recent Intel
+// CPUs only, works without frame pointers but is limited to ~32 frames).
+//
+// Mode "offcpu" records the stack of every context switch of the child
+// instead and weights it with the time until the thread runs again (in us),
+// i.e., shows where threads block on futexes, I/O or sleeps. Stacks start
+// with [blocked] or [preempted] and include kernel frames when permitted.
+// Without perf_event_open, `wchan_sampler` provides a coarse fallback.
+
+namespace profiler {
+
+// ELF symbol table of a single file, loaded on first use
+class symbol_table {
+public:
+  explicit symbol_table(const std::string& path) {
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (fstat(fd, &st) == 0
+        && st.st_size >= static_cast<off_t>(sizeof(Elf64_Ehdr))) {
+      auto size = static_cast<size_t>(st.st_size);
+      auto ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (ptr != MAP_FAILED) {
+        load(static_cast<const char*>(ptr), size);
+        munmap(ptr, size);
+      }
+    }
+    close(fd);
+  }
+
+  // returns the demangled function containing `offset` (a file offset), or
+  // an empty string if none does
+  std::string lookup(uint64_t offset) const {
+    uint64_t vaddr = 0;
+    bool found = false;
+    for (auto& seg : segments_) {
+      if (offset >= seg.offset && offset < seg.offset + seg.size) {
+        vaddr = offset - seg.offset + seg.vaddr;
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+      return std::string{};
+    auto i = std::upper_bound(symbols_.begin(), symbols_.end(), vaddr,
+                              [](uint64_t x, const symbol& y) {
+                                return x < y.addr;
+                              });
+    if (i == symbols_.begin())
+      return std::string{};
+    --i;
+    if (vaddr >= i->addr + std::max(i->size, uint64_t{1}))
+      return std::string{};
+    return demangle(i->name);
+  }
+
+private:
+  struct symbol {
+    uint64_t addr;
+    uint64_t size;
+    std::string name;
+  };
+
+  struct segment {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t vaddr;
+  };
+
+  static std::string demangle(const std::string& name) {
+    int status = 0;
+    auto res = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+    if (status != 0 || res == nullptr)
+      return name;
+    std::string result = res;
+    free(res);
+    return result;
+  }
+
+  // reads PT_LOAD segments and STT_FUNC symbols of .symtab and .dynsym,
+  // only 64-bit ELF files are supported
+  void load(const char* data, size_t size) {
+    auto ehdr = reinterpret_cast<const Elf64_Ehdr*>(data);
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0
+        || ehdr->e_ident[EI_CLASS] != ELFCLASS64)
+      return;
+    auto in_range = [&](uint64_t off, uint64_t len) {
+      return off <= size && len <= size - off;
+    };
+    if (in_range(ehdr->e_phoff, uint64_t{ehdr->e_phnum} * sizeof(Elf64_Phdr))) {
+      auto phdrs = reinterpret_cast<const Elf64_Phdr*>(data + ehdr->e_phoff);
+      for (size_t i = 0; i < ehdr->e_phnum; ++i)
+        if (phdrs[i].p_type == PT_LOAD)
+          segments_.push_back(segment{phdrs[i].p_offset, phdrs[i].p_filesz,
+                                      phdrs[i].p_vaddr});
+    }
+    if (!in_range(ehdr->e_shoff, uint64_t{ehdr->e_shnum} * sizeof(Elf64_Shdr)))
+      return;
+    auto shdrs = reinterpret_cast<const Elf64_Shdr*>(data + ehdr->e_shoff);
+    for (size_t i = 0; i < ehdr->e_shnum; ++i) {
+      auto& sh = shdrs[i];
+      if ((sh.sh_type != SHT_SYMTAB && sh.sh_type != SHT_DYNSYM)
+          || sh.sh_link >= ehdr->e_shnum || !in_range(sh.sh_offset, sh.sh_size))
+        continue;
+      auto& strtab = shdrs[sh.sh_link];
+      if (!in_range(strtab.sh_offset, strtab.sh_size))
+        continue;
+      auto syms = reinterpret_cast<const Elf64_Sym*>(data + sh.sh_offset);
+      auto num_syms = sh.sh_size / sizeof(Elf64_Sym);
+      for (size_t j = 0; j < num_syms; ++j) {
+        auto& sym = syms[j];
+        if (ELF64_ST_TYPE(sym.st_info) != STT_FUNC || sym.st_value == 0
+            || sym.st_name >= strtab.sh_size)
+          continue;
+        auto name = data + strtab.sh_offset + sym.st_name;
+        auto len = strnlen(name, strtab.sh_size - sym.st_name);
+        symbols_.push_back(symbol{sym.st_value, sym.st_size,
+                                  std::string{name, len}});
+      }
+    }
+    std::sort(symbols_.begin(), symbols_.end(),
+              [](const symbol& x, const symbol& y) { return x.addr < y.addr; });
+  }
+
+  std::vector<segment> segments_;
+  std::vector<symbol> symbols_;
+};
+
+// executable mapping of a process, from PERF_RECORD_MMAP
+struct mapping {
+  uint64_t start;
+  uint64_t len;
+  uint64_t pgoff;
+  std::string file;
+};
+
+// kernel symbols from /proc/kallsyms, addresses read as 0 unless root
+class kernel_symbols {
+public:
+  kernel_symbols() {
+    std::ifstream in{"/proc/kallsyms"};
+    std::string line;
+    while (std::getline(in, line)) {
+      // "<addr> <type> <name> [module]"
+      char* end = nullptr;
+      auto addr = strtoull(line.c_str(), &end, 16);
+      if (addr == 0 || end == nullptr || end[0] != ' ' || end[1] == '\0'
+          || (end[1] != 't' && end[1] != 'T') || end[2] != ' ')
+        continue;
+      std::string name = end + 3;
+      auto sep = name.find_first_of(" \t");
+      if (sep != std::string::npos)
+        name.erase(sep);
+      symbols_.emplace_back(addr, std::move(name));
+    }
+    std::sort(symbols_.begin(), symbols_.end());
+  }
+
+  std::string lookup(uint64_t addr) const {
+    auto i = std::upper_bound(symbols_.begin(), symbols_.end(),
+                              std::make_pair(addr, std::string{"\xff"}));
+    if (i == symbols_.begin())
+      return "[kernel]";
+    return (i - 1)->second + "_[k]";
+  }
+
+private:
+  std::vector<std::pair<uint64_t, std::string>> symbols_;
+};
+
+// kernel text lives in the upper half of the address space
+inline bool is_kernel_address(uint64_t addr) {
+  return addr >= 0xffff800000000000ull;
+}
+
+} // namespace profiler
+
+class sampling_profiler {
+public:
+  sampling_profiler(std::string mode, int frequency)
+      : mode_(std::move(mode)),
+        frequency_(frequency),
+        running_(true) {
+    // nop
+  }
+
+  sampling_profiler(const sampling_profiler&) = delete;
+  sampling_profiler& operator=(const sampling_profiler&) = delete;
+
+  ~sampling_profiler() {
+    for (auto& buf : buffers_) {
+      munmap(buf.base, buf.size);
+      close(buf.fd);
+    }
+  }
+
+  // opens one sampling event per online CPU for `pid`, inherited by all of
+  // its threads and child processes and enabled once `pid` calls exec;
+  // prints an error and returns false on failure
+  bool attach(pid_t pid) {
+    if (mode_ != "fp" && mode_ != "lbr" && mode_ != "offcpu") {
+      std::cerr << "unknown profile mode: " << mode_
+                << " (expected fp|lbr|offcpu)" << std::endl;
+      return false;
+    }
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.freq = 1;
+    attr.sample_freq = static_cast<uint64_t>(frequency_);
+    attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID;
+    if (mode_ == "offcpu") {
+      // sample each switch-out, PERF_RECORD_SWITCH marks the switch-in
+      attr.type = PERF_TYPE_SOFTWARE;
+      attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+      attr.freq = 0;
+      attr.sample_period = 1;
+      attr.sample_type |= PERF_SAMPLE_TIME | PERF_SAMPLE_CALLCHAIN;
+      attr.sample_id_all = 1;
+      attr.context_switch = 1;
+    } else if (mode_ == "fp") {
+      attr.sample_type |= PERF_SAMPLE_CALLCHAIN;
+      attr.exclude_callchain_kernel = 1;
+    } else {
+      attr.sample_type |= PERF_SAMPLE_BRANCH_STACK;
+      attr.branch_sample_type = PERF_SAMPLE_BRANCH_USER
+                                | PERF_SAMPLE_BRANCH_CALL_STACK;
+    }
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    // context switches happen in the kernel
+    attr.exclude_kernel = mode_ == "offcpu" ? 0 : 1;
+    attr.exclude_hv = 1;
+    attr.mmap = 1;
+    attr.comm = 1;
+    attr.task = 1;
+    auto num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    for (int cpu = 0; cpu < num_cpus; ++cpu) {
+      auto fd = open_event(attr, pid, cpu);
+      if (fd < 0 && mode_ == "fp" && (errno == ENOENT || errno == EOPNOTSUPP)) {
+        // no hardware counters (e.g. in VMs), fall back to a timer
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_CPU_CLOCK;
+        fd = open_event(attr, pid, cpu);
+      }
+      if (fd < 0) {
+        if (errno == ENODEV || errno == EINVAL)
+          continue; // offline CPU
+        perror(mode_ == "lbr" ? "perf_event_open (lbr needs Intel LBR)"
+                              : mode_ == "offcpu"
+                                ? "perf_event_open (offcpu needs root)"
+                                : "perf_event_open");
+        return false;
+      }
+      auto size = (1 + buffer_pages()) * page_size();
+      auto base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                       0);
+      if (base == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        return false;
+      }
+      buffers_.push_back(ring_buffer{fd, base, size});
+    }
+    if (buffers_.empty()) {
+      std::cerr << "no CPU available for profiling" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // drains the ring buffers until `stop` gets called, then drains them a
+  // last time; runs in its own thread
+  void run() {
+    std::vector<pollfd> fds;
+    for (auto& buf : buffers_)
+      fds.push_back(pollfd{buf.fd, POLLIN, 0});
+    while (running_) {
+      poll(fds.data(), fds.size(), 10);
+      drain();
+    }
+    drain();
+  }
+
+  void stop() {
+    running_ = false;
+  }
+
+  size_t samples() const {
+    return num_samples_;
+  }
+
+  size_t lost() const {
+    return num_lost_;
+  }
+
+  // writes one "thread;outermost;...;innermost count" line per distinct
+  // stack, symbolized from the files the processes had mapped; the count is
+  // the number of samples or, in offcpu mode, the time off-CPU in us
+  void write_folded(std::ostream& out) {
+    std::map<std::string, uint64_t> folded;
+    if (mode_ == "offcpu") {
+      fold(stacks_, ";[blocked]", folded);
+      fold(preempted_, ";[preempted]", folded);
+    } else {
+      fold(stacks_, "", folded);
+    }
+    for (auto& kvp : folded)
+      out << kvp.first << " " << kvp.second << "\n";
+    out.flush();
+  }
+
+private:
+  // (pid, tid, innermost-first addresses) => samples or time off-CPU
+  using stack_map = std::map<std::tuple<pid_t, pid_t, std::vector<uint64_t>>,
+                             uint64_t>;
+
+  // sample taken when a thread leaves the CPU in offcpu mode, kept until
+  // the thread runs again
+  struct switch_out {
+    uint64_t time;
+    stack_map::iterator stack;
+    bool preempted;
+  };
+
+  struct ring_buffer {
+    int fd;
+    void* base;
+    size_t size;
+  };
+
+  // must be a power of 2, context switches produce far more records
+  size_t buffer_pages() const {
+    return mode_ == "offcpu" ? 1024 : 128;
+  }
+
+  static size_t page_size() {
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  }
+
+  static int open_event(perf_event_attr& attr, pid_t pid, int cpu) {
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, cpu, -1,
+                                    PERF_FLAG_FD_CLOEXEC));
+  }
+
+  void drain() {
+    for (auto& buf : buffers_) {
+      auto meta = static_cast<perf_event_mmap_page*>(buf.base);
+      auto data = static_cast<char*>(buf.base) + page_size();
+      auto data_size = buffer_pages() * page_size();
+      auto head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+      auto tail = meta->data_tail;
+      std::vector<char> record;
+      while (tail < head) {
+        perf_event_header hdr;
+        copy_out(data, data_size, tail, &hdr, sizeof(hdr));
+        if (hdr.size < sizeof(hdr))
+          break;
+        record.resize(hdr.size);
+        copy_out(data, data_size, tail, record.data(), hdr.size);
+        handle(hdr, record.data() + sizeof(hdr), hdr.size - sizeof(hdr));
+        tail += hdr.size;
+      }
+      __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+    }
+  }
+
+  static void copy_out(const char* data, size_t data_size, uint64_t pos,
+                       void* dest, size_t n) {
+    auto offset = pos & (data_size - 1);
+    auto first = std::min(n, data_size - offset);
+    memcpy(dest, data + offset, first);
+    memcpy(static_cast<char*>(dest) + first, data, n - first);
+  }
+
+  void handle(const perf_event_header& hdr, const char* body, size_t size) {
+    auto u64 = [&](size_t i) {
+      uint64_t result = 0;
+      if ((i + 1) * sizeof(uint64_t) <= size)
+        memcpy(&result, body + i * sizeof(uint64_t), sizeof(uint64_t));
+      return result;
+    };
+    auto u32 = [&](size_t i) {
+      uint32_t result = 0;
+      if ((i + 1) * sizeof(uint32_t) <= size)
+        memcpy(&result, body + i * sizeof(uint32_t), sizeof(uint32_t));
+      return result;
+    };
+    switch (hdr.type) {
+      case PERF_RECORD_SAMPLE: {
+        // ip, pid/tid, time (offcpu only), then callchain (fp, offcpu) or
+        // branch stack (lbr)
+        std::vector<uint64_t> ips{u64(0)};
+        auto pid = static_cast<pid_t>(u32(2));
+        auto tid = static_cast<pid_t>(u32(3));
+        size_t first = mode_ == "offcpu" ? 3 : 2;
+        auto nr = u64(first++);
+        if (mode_ != "lbr") {
+          // skips PERF_CONTEXT_* markers and the copy of ip that starts
+          // the callchain
+          bool leaf = true;
+          for (size_t i = 0; i < nr && first + i < size / 8; ++i) {
+            auto ip = u64(first + i);
+            if (ip >= static_cast<uint64_t>(PERF_CONTEXT_MAX))
+              continue;
+            if (!leaf || ip != ips[0])
+              ips.push_back(ip);
+            leaf = false;
+          }
+        } else {
+          // entries are {from, to, flags}, the call site is `from`
+          for (size_t i = 0; i < nr && first + 3 * i < size / 8; ++i)
+            ips.push_back(u64(first + 3 * i));
+        }
+        auto key = std::make_tuple(pid, tid, std::move(ips));
+        if (mode_ == "offcpu") {
+          auto stack = stacks_.emplace(std::move(key), 0).first;
+          pending_out_[tid] = switch_out{u64(2), stack, false};
+        } else {
+          ++stacks_[std::move(key)];
+        }
+        ++num_samples_;
+        break;
+      }
+      case PERF_RECORD_SWITCH: {
+        // sample_id: pid, tid, time; the switch-out record directly
+        // follows the sample of the same context switch, but the
+        // switch-in may come from another CPU's buffer and arrive first
+        auto tid = static_cast<pid_t>(u32(1));
+        auto time = u64(1);
+        auto out = pending_out_.find(tid);
+        if ((hdr.misc & PERF_RECORD_MISC_SWITCH_OUT) != 0) {
+          if (out == pending_out_.end())
+            break;
+          if ((hdr.misc & PERF_RECORD_MISC_SWITCH_OUT_PREEMPT) != 0)
+            out->second.preempted = true;
+          auto in = pending_in_.find(tid);
+          if (in != pending_in_.end() && in->second >= out->second.time) {
+            add_off_cpu(out->second, in->second);
+            pending_out_.erase(out);
+            pending_in_.erase(in);
+          }
+        } else if (out != pending_out_.end() && out->second.time <= time) {
+          add_off_cpu(out->second, time);
+          pending_out_.erase(out);
+        } else {
+          pending_in_[tid] = time;
+        }
+        break;
+      }
+      case PERF_RECORD_MMAP: {
+        // pid, tid, addr, len, pgoff, filename
+        if (size <= 32)
+          break;
+        auto pid = static_cast<pid_t>(u32(0));
+        auto name = body + 32;
+        std::string file{name, strnlen(name, size - 32)};
+        maps_[pid].push_back(profiler::mapping{u64(1), u64(2), u64(3),
+                                               std::move(file)});
+        break;
+      }
+      case PERF_RECORD_COMM: {
+        // pid, tid, comm
+        if (size <= 8)
+          break;
+        auto name = body + 8;
+        comms_[static_cast<pid_t>(u32(1))].assign(name,
+                                                  strnlen(name, size - 8));
+        break;
+      }
+      case PERF_RECORD_FORK: {
+        // pid, ppid, tid, ptid; new processes share the mappings of their
+        // parent until they call exec
+        auto pid = static_cast<pid_t>(u32(0));
+        auto ppid = static_cast<pid_t>(u32(1));
+        if (pid != ppid)
+          parents_[pid] = ppid;
+        auto tid = static_cast<pid_t>(u32(2));
+        auto ptid = static_cast<pid_t>(u32(3));
+        if (comms_.count(tid) == 0 && comms_.count(ptid) > 0)
+          comms_[tid] = comms_[ptid];
+        break;
+      }
+      case PERF_RECORD_LOST:
+        // id, lost
+        num_lost_ += u64(1);
+        break;
+      default:
+        break;
+    }
+  }
+
+  // charges the time between a switch-out and the following switch-in
+  void add_off_cpu(const switch_out& x, uint64_t switch_in) {
+    auto us = (switch_in - x.time) / 1000;
+    if (x.preempted)
+      preempted_[x.stack->first] += us;
+    else
+      x.stack->second += us;
+  }
+
+  void fold(const stack_map& stacks, const char* prefix,
+            std::map<std::string, uint64_t>& folded) {
+    for (auto& kvp : stacks) {
+      if (kvp.second == 0)
+        continue;
+      auto pid = std::get<0>(kvp.first);
+      auto tid = std::get<1>(kvp.first);
+      auto& ips = std::get<2>(kvp.first);
+      auto comm = comms_.find(tid);
+      if (comm == comms_.end())
+        comm = comms_.find(pid);
+      std::string line = comm != comms_.end() ? comm->second : "[unknown]";
+      line += prefix;
+      // callchains are innermost first and hold return addresses for all
+      // but the first entry, which would resolve to the next instruction
+      for (size_t i = ips.size(); i-- > 0;)
+        line += ";" + symbolize(pid, i == 0 ? ips[i] : ips[i] - 1);
+      folded[line] += kvp.second;
+    }
+  }
+
+  std::string symbolize(pid_t pid, uint64_t addr) {
+    if (profiler::is_kernel_address(addr)) {
+      if (!kernel_)
+        kernel_.reset(new profiler::kernel_symbols);
+      return kernel_->lookup(addr);
+    }
+    for (auto p = pid; p != 0;) {
+      auto& maps = maps_[p];
+      // later mappings replace earlier ones, e.g., after exec
+      for (auto i = maps.rbegin(); i != maps.rend(); ++i) {
+        if (addr < i->start || addr >= i->start + i->len)
+          continue;
+        auto& table = tables_[i->file];
+        if (!table)
+          table.reset(new profiler::symbol_table(i->file));
+        auto result = table->lookup(addr - i->start + i->pgoff);
+        if (!result.empty())
+          return result;
+        auto sep = i->file.rfind('/');
+        return "[" + (sep == std::string::npos ? i->file
+                                               : i->file.substr(sep + 1))
+               + "]";
+      }
+      auto parent = parents_.find(p);
+      p = parent != parents_.end() ? parent->second : 0;
+    }
+    return "[unknown]";
+  }
+
+  std::string mode_;
+  int frequency_;
+  std::atomic<bool> running_;
+  std::vector<ring_buffer> buffers_;
+  size_t num_samples_ = 0;
+  size_t num_lost_ = 0;
+  stack_map stacks_;
+  // offcpu mode only, pending state is bounded by the number of threads
+  stack_map preempted_;
+  std::map<pid_t, switch_out> pending_out_;
+  std::map<pid_t, uint64_t> pending_in_; // switch-ins seen before their out
+  std::unique_ptr<profiler::kernel_symbols> kernel_;
+  std::map<pid_t, std::vector<profiler::mapping>> maps_;
+  std::map<pid_t, std::string> comms_;
+  std::map<pid_t, pid_t> parents_;
+  std::map<std::string, std::unique_ptr<profiler::symbol_table>> tables_;
+};
+
+// Fallback for the offcpu mode without perf_event_open: polls state, wait
+// channel and current syscall of every thread of a process and charges the
+// poll interval to "thread;[blocked];function;syscall;wchan" for each thread
+// found sleeping. Only sees the innermost user frame (the syscall wrapper)
+// and misses short waits, but needs no privileges beyond reading /proc.
+class wchan_sampler {
+public:
+  wchan_sampler(pid_t pid, int frequency)
+      : pid_(pid),
+        interval_(std::chrono::microseconds{1000000 / std::max(frequency, 1)}),
+        running_(true),
+        num_samples_(0) {
+    // nop
+  }
+
+  wchan_sampler(const wchan_sampler&) = delete;
+  wchan_sampler& operator=(const wchan_sampler&) = delete;
+
+  void run() {
+    auto task_dir = "/proc/" + std::to_string(pid_) + "/task";
+    auto last = std::chrono::steady_clock::now();
+    while (running_) {
+      std::this_thread::sleep_for(interval_);
+      auto now = std::chrono::steady_clock::now();
+      auto us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(now - last)
+          .count());
+      last = now;
+      auto dir = opendir(task_dir.c_str());
+      if (dir == nullptr)
+        continue; // not started yet or already gone
+      while (auto entry = readdir(dir))
+        if (entry->d_name[0] != '.')
+          sample(task_dir + "/" + entry->d_name, us);
+      closedir(dir);
+    }
+  }
+
+  void stop() {
+    running_ = false;
+  }
+
+  size_t samples() const {
+    return num_samples_;
+  }
+
+  void write_folded(std::ostream& out) {
+    for (auto& kvp : folded_)
+      out << kvp.first << " " << kvp.second << "\n";
+    out.flush();
+  }
+
+private:
+  static std::string read_line(const std::string& path) {
+    std::ifstream in{path};
+    std::string result;
+    std::getline(in, result);
+    return result;
+  }
+
+  static std::string syscall_name(long nr) {
+    static const std::pair<long, const char*> names[] = {
+#define SYSCALL_NAME(x) {SYS_##x, #x}
+      SYSCALL_NAME(futex), SYSCALL_NAME(read), SYSCALL_NAME(write),
+      SYSCALL_NAME(ppoll), SYSCALL_NAME(pselect6), SYSCALL_NAME(epoll_pwait),
+      SYSCALL_NAME(recvfrom), SYSCALL_NAME(recvmsg), SYSCALL_NAME(sendto),
+      SYSCALL_NAME(sendmsg), SYSCALL_NAME(accept4), SYSCALL_NAME(connect),
+      SYSCALL_NAME(nanosleep), SYSCALL_NAME(clock_nanosleep),
+      SYSCALL_NAME(wait4), SYSCALL_NAME(sched_yield),
+#ifdef SYS_poll
+      SYSCALL_NAME(poll), SYSCALL_NAME(select), SYSCALL_NAME(epoll_wait),
+#endif
+#undef SYSCALL_NAME
+    };
+    for (auto& x : names)
+      if (x.first == nr)
+        return x.second;
+    return "syscall_" + std::to_string(nr);
+  }
+
+  // one observation of the thread in `dir`
+  void sample(const std::string& dir, uint64_t us) {
+    auto stat = read_line(dir + "/stat");
+    auto last = stat.rfind(')');
+    auto first = stat.find('(');
+    if (first == std::string::npos || last == std::string::npos
+        || last + 2 >= stat.size())
+      return;
+    auto state = stat[last + 2];
+    // only sleeping (S) and uninterruptible (D) threads are off-CPU
+    if (state != 'S' && state != 'D')
+      return;
+    ++num_samples_;
+    std::string line = stat.substr(first + 1, last - first - 1);
+    line += ";[blocked]";
+    // "<nr> <args...> <sp> <pc>", "running" or "-1 <sp> <pc>"
+    std::istringstream syscall_info{read_line(dir + "/syscall")};
+    std::vector<std::string> fields;
+    std::string field;
+    while (syscall_info >> field)
+      fields.push_back(field);
+    if (fields.size() >= 3 && fields[0] != "-1") {
+      auto pc = strtoull(fields.back().c_str(), nullptr, 16);
+      line += ";" + symbolize(pc > 0 ? pc - 1 : pc);
+      line += ";" + syscall_name(atol(fields[0].c_str()));
+    }
+    auto wchan = read_line(dir + "/wchan");
+    if (!wchan.empty() && wchan != "0")
+      line += ";" + wchan + "_[k]";
+    folded_[line] += us;
+  }
+
+  // resolves a user address via /proc/<pid>/maps, rereading it once per
+  // unknown address to pick up libraries loaded in the meantime
+  std::string symbolize(uint64_t addr) {
+    for (int attempt = 0; attempt < 2; ++attempt) {
+      for (auto& m : maps_) {
+        if (addr < m.start || addr >= m.start + m.len)
+          continue;
+        auto& table = tables_[m.file];
+        if (!table)
+          table.reset(new profiler::symbol_table(m.file));
+        auto result = table->lookup(addr - m.start + m.pgoff);
+        if (!result.empty())
+          return result;
+        auto sep = m.file.rfind('/');
+        return "[" + (sep == std::string::npos ? m.file
+                                               : m.file.substr(sep + 1))
+               + "]";
+      }
+      if (attempt == 0)
+        read_maps();
+    }
+    return "[unknown]";
+  }
+
+  void read_maps() {
+    maps_.clear();
+    std::ifstream in{"/proc/" + std::to_string(pid_) + "/maps"};
+    std::string line;
+    while (std::getline(in, line)) {
+      // "start-end perms offset dev inode path"
+      std::istringstream fields{line};
+      std::string range, perms, offset, dev, inode, path;
+      if (!(fields >> range >> perms >> offset >> dev >> inode >> path)
+          || perms.find('x') == std::string::npos)
+        continue;
+      auto start = strtoull(range.c_str(), nullptr, 16);
+      auto end = strtoull(range.c_str() + range.find('-') + 1, nullptr, 16);
+      maps_.push_back(profiler::mapping{start, end - start,
+                                        strtoull(offset.c_str(), nullptr, 16),
+                                        path});
+    }
+  }
+
+  pid_t pid_;
+  std::chrono::microseconds interval_;
+  std::atomic<bool> running_;
+  size_t num_samples_;
+  std::map<std::string, uint64_t> folded_;
+  std::vector<profiler::mapping> maps_;
+  std::map<std::string, std::unique_ptr<profiler::symbol_table>> tables_;
+};
+
+#endif // SAMPLING_PROFILER_HPP
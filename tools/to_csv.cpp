@@ -68,6 +68,9 @@ using file_name = std::string;
 enum benchmark_file_type {
   runtime_values,
   memory_values,
+  numa_local_values,
+  numa_other_values,
+  energy_values,
   invalid_file
 };
 
@@ -87,6 +90,14 @@ bool has_runtime_values(const benchmark_file& bf) {
   return bf.type == runtime_values;
 }
 
+bool has_numa_values(const benchmark_file& bf) {
+  return bf.type == numa_local_values || bf.type == numa_other_values;
+}
+
+bool has_energy_values(const benchmark_file& bf) {
+  return bf.type == energy_values;
+}
+
 bool is_invalid_file(const benchmark_file& bf) {
   return bf.type == invalid_file;
 }
@@ -110,9 +121,26 @@ constexpr const char* field_names [num_field_names] = {
   "BENCHMARK"
 };
 
+// fields written by caf_run_bench to $RUNTIME_FILE.fingerprint that must
+// agree for all runs merged into one CSV file; load_average is informational
+constexpr const char* machine_fingerprint_keys[] = {
+  "cpu_model",
+  "governor",
+  "max_freq_khz",
+  "turbo",
+  "thp",
+  "kernel",
+  "compiler",
+  "cxx_flags",
+  "caf_version",
+  "profile"
+};
+
 void print_help(int exit_code) {
-  cout << "to_csv [-f FORMAT] FILES..." << endl
-       << "default format string: " << file_name_default_format << endl;
+  cout << "to_csv [--force] [-f FORMAT] FILES..." << endl
+       << "default format string: " << file_name_default_format << endl
+       << "--force: merge runs with differing environment fingerprints"
+       << endl;
   exit(exit_code);
 }
 
@@ -161,7 +189,7 @@ pair<regex, map<string, size_t>> read_format(const char* format_str) {
   std::string fstr = format_str;
   replace_all(fstr, "{X-VALUE}", "([0-9]+)");
   replace_all(fstr, "{X-LABEL}", "([a-zA-Z_\\-]+)");
-  replace_all(fstr, "{MEMORY_OR_RUNTIME}", "(runtime|memory_[0-9]+)");
+  replace_all(fstr, "{MEMORY_OR_RUNTIME}", "(runtime|memory_[0-9]+|numa_local|numa_other|energy)");
   replace_all(fstr, "{LABEL}", "([a-zA-Z0-9\\-]+)");
   replace_all(fstr, "{BENCHMARK}", "([a-zA-Z_\\-]+)");
   regex rx{fstr};
@@ -170,8 +198,9 @@ pair<regex, map<string, size_t>> read_format(const char* format_str) {
 
 class application {
  public:
-  application(pair<regex, map<string, size_t>> field_conf)
-      : m_nice_names{{"caf",     "CAF"},
+  application(pair<regex, map<string, size_t>> field_conf, bool force)
+      : m_force{force},
+        m_nice_names{{"caf",     "CAF"},
                      {"scala",   "Scala"},
                      {"salsa",   "SalsaLite"},
                      {"theron",  "Theron"},
@@ -198,9 +227,17 @@ class application {
       if (regex_match(fname, rxres, m_fname_rx) && rxres.size() == 6) {
         res.num_units = stoul(rxres.str(m_fname_ids["X-VALUE"]));
         m_unit_name = rxres.str(m_fname_ids["X-LABEL"]);
-        res.type = rxres.str(m_fname_ids["MEMORY_OR_RUNTIME"]) == "runtime"
-                             ? runtime_values
-                             : memory_values;
+        auto type = rxres.str(m_fname_ids["MEMORY_OR_RUNTIME"]);
+        if (type == "runtime")
+          res.type = runtime_values;
+        else if (type == "numa_local")
+          res.type = numa_local_values;
+        else if (type == "numa_other")
+          res.type = numa_other_values;
+        else if (type == "energy")
+          res.type = energy_values;
+        else
+          res.type = memory_values;
         res.framework = rxres.str(m_fname_ids["LABEL"]);
         res.benchmark_name = rxres.str(m_fname_ids["BENCHMARK"]);
         res.path = std::move(fname);
@@ -224,6 +261,25 @@ class application {
     sort(benchs.begin(), benchs.end());
     benchs.erase(unique(benchs.begin(), benchs.end()), benchs.end());
     m_benchmarks.swap(benchs);
+    if (!check_fingerprints(files) && !m_force) {
+      cerr << "*** refusing to merge runs from different environments, "
+              "use --force to override" << endl;
+      exit(1);
+    }
+    // NUMA files go to their own CSV files
+    auto first_numa = partition(files.begin(), files.end(),
+                                [](const benchmark_file& bf) {
+                                  return !has_numa_values(bf);
+                                });
+    convert_numa_files(first_numa, files.end());
+    files.erase(first_numa, files.end());
+    // same for energy files
+    auto first_energy = partition(files.begin(), files.end(),
+                                  [](const benchmark_file& bf) {
+                                    return !has_energy_values(bf);
+                                  });
+    convert_energy_files(first_energy, files.end());
+    files.erase(first_energy, files.end());
     // separate
     auto first_mem = partition(files.begin(), files.end(), has_runtime_values);
     // sort subranges by benchmark name
@@ -370,6 +426,147 @@ class application {
     convert_mem_files(eor, last);
   }
 
+  // writes one numa_$benchmark.csv per benchmark with the mean per run for
+  // each framework and number of units; columns of the input files are
+  // pages allocated, numa_hit or numa_miss, and resident kB
+  void convert_numa_files(iterator first, iterator last) {
+    // $benchmark => {$framework => {$num_units => [$sums]}}
+    using sums = array<double, 7>;
+    map<string, map<string, map<size_t, sums>>> samples;
+    for (; first != last; ++first) {
+      auto vals = content(first->path, 3);
+      auto& out = samples[first->benchmark_name][first->framework]
+                         [first->num_units];
+      // local values go to columns 0-2, remote values to 3-5
+      size_t offset = first->type == numa_local_values ? 0 : 3;
+      for (auto& row : vals)
+        for (size_t i = 0; i < 3; ++i)
+          out[offset + i] += row[i];
+      if (first->type == numa_local_values)
+        out[6] += static_cast<double>(vals.size());
+    }
+    for (auto& bench : samples) {
+      ofstream ofile{"numa_" + bench.first + ".csv"};
+      ofile << m_unit_name << ", framework, local_pages, remote_pages"
+            << ", remote_ratio, numa_hit, numa_miss, home_kB, remote_kB"
+            << newline;
+      for (auto& framework : bench.second) {
+        auto iter = m_nice_names.find(framework.first);
+        auto& out_name = iter == m_nice_names.end() ? framework.first
+                                                    : iter->second;
+        for (auto& kvp : framework.second) {
+          auto& x = kvp.second;
+          auto runs = max(x[6], 1.);
+          auto total = x[0] + x[3];
+          ofile << kvp.first << ", " << out_name
+                << ", " << x[0] / runs << ", " << x[3] / runs
+                << ", " << (total > 0 ? x[3] / total : 0.)
+                << ", " << x[1] / runs << ", " << x[4] / runs
+                << ", " << x[2] / runs << ", " << x[5] / runs << newline;
+        }
+      }
+    }
+  }
+
+  // writes one energy_$benchmark.csv per benchmark with mean and 95%
+  // confidence interval of package J, DRAM J and J per unit of work
+  void convert_energy_files(iterator first, iterator last) {
+    // $benchmark => {$framework => {$num_units => [$column => [$values]]}}
+    using columns = array<vector<double>, 3>;
+    map<string, map<string, map<size_t, columns>>> samples;
+    for (; first != last; ++first) {
+      auto& out = samples[first->benchmark_name][first->framework]
+                         [first->num_units];
+      for (auto& row : content(first->path, 3))
+        for (size_t i = 0; i < 3; ++i)
+          out[i].push_back(row[i]);
+    }
+    for (auto& bench : samples) {
+      ofstream ofile{"energy_" + bench.first + ".csv"};
+      ofile << m_unit_name << ", framework, package_J, package_J_yerr"
+            << ", dram_J, dram_J_yerr, J_per_unit, J_per_unit_yerr" << newline;
+      for (auto& framework : bench.second) {
+        auto iter = m_nice_names.find(framework.first);
+        auto& out_name = iter == m_nice_names.end() ? framework.first
+                                                    : iter->second;
+        for (auto& kvp : framework.second) {
+          if (kvp.second[0].empty())
+            continue;
+          ofile << kvp.first << ", " << out_name;
+          for (auto& column : kvp.second) {
+            statistics stats{column};
+            auto yerr = column.size() < 9 ? 0. : stats.conf_interval_95;
+            ofile << ", " << stats.mean << ", " << yerr;
+          }
+          ofile << newline;
+        }
+      }
+    }
+  }
+
+  // $key => $value for each block of a fingerprint file
+  vector<map<string, string>> read_fingerprints(const file_name& fname) {
+    vector<map<string, string>> result;
+    ifstream f{fname};
+    string line;
+    map<string, string> block;
+    while (getline(f, line)) {
+      auto sep = line.find(": ");
+      if (sep != string::npos) {
+        block[line.substr(0, sep)] = line.substr(sep + 2);
+      } else if (!block.empty()) {
+        result.push_back(move(block));
+        block.clear();
+      }
+    }
+    if (!block.empty())
+      result.push_back(move(block));
+    return result;
+  }
+
+  // compares the fingerprints of all runs in `files`: machine-level fields
+  // must agree everywhere, the binary per framework and benchmark, and the
+  // core set per x-value; prints each conflict once
+  bool check_fingerprints(const vector<benchmark_file>& files) {
+    // $scope => $key => ($value, $path of first occurrence)
+    map<string, map<string, pair<string, string>>> seen;
+    bool result = true;
+    auto check = [&](const string& scope, const string& key,
+                     const string& value, const string& path) {
+      auto& entry = seen[scope][key];
+      if (entry.second.empty()) {
+        entry = make_pair(value, path);
+      } else if (entry.first != value && entry.second != "conflict") {
+        cerr << "*** fingerprint mismatch in " << key << ": \""
+             << entry.first << "\" (" << entry.second << ") vs. \"" << value
+             << "\" (" << path << ")" << endl;
+        entry.second = "conflict";
+        result = false;
+      }
+    };
+    for (auto& bf : files) {
+      if (bf.type != runtime_values)
+        continue;
+      auto fname = bf.path + ".fingerprint";
+      auto blocks = read_fingerprints(fname);
+      if (blocks.empty()) {
+        cerr << "*** no fingerprint found for " << bf.path << endl;
+        continue;
+      }
+      for (auto& block : blocks) {
+        // fingerprints without a profile field predate profiling
+        if (block["profile"].empty())
+          block["profile"] = "none";
+        for (auto key : machine_fingerprint_keys)
+          check("", key, block[key], fname);
+        check(bf.framework + "/" + bf.benchmark_name, "binary",
+              block["binary"], fname);
+        check(to_string(bf.num_units), "core_set", block["core_set"], fname);
+      }
+    }
+    return result;
+  }
+
   vector<vector<double>> content(const file_name& fname, size_t row_size) {
     vector<vector<double>> result;
     string line;
@@ -393,6 +590,7 @@ class application {
     return {};
   }
 
+  bool m_force;
   map<string, string> m_nice_names;
   regex m_fname_rx;
   map<string, size_t> m_fname_ids;
@@ -403,6 +601,12 @@ class application {
 };
 
 int main(int argc, char** argv) {
+  bool force = false;
+  if (argc >= 2 && strcmp(argv[1], "--force") == 0) {
+    force = true;
+    ++argv;
+    --argc;
+  }
   int offset = 0;
   pair<regex, map<string, size_t>> format_config;
   if (argc >= 3 && strcmp(argv[1], "-f") == 0) {
@@ -411,6 +615,6 @@ int main(int argc, char** argv) {
   } else {
     format_config = read_format(file_name_default_format);
   }
-  application app{std::move(format_config)};
+  application app{std::move(format_config), force};
   app.run({argv + 1 + offset, argv + argc});
 }